@@ -49,6 +49,7 @@
 #include <libaudcore/ringbuf.h>
 
 #include "alsa.h"
+#include "../effect-common/dither.h"
 
 EXPORT ALSAPlugin aud_plugin_instance;
 
@@ -74,6 +75,12 @@ static pthread_cond_t alsa_cond = PTHREAD_COND_INITIALIZER;
 static snd_pcm_format_t alsa_format;
 static int alsa_channels, alsa_rate;
 
+/* floating point audio for a device that takes only integers */
+static bool alsa_requantize;
+static int alsa_sample_size; /* bytes */
+static Requantizer alsa_requantizer;
+static Index<char> alsa_converted;
+
 static RingBuf<char> alsa_buffer;
 static int alsa_period; /* milliseconds */
 
@@ -309,6 +316,20 @@ static snd_pcm_format_t convert_aud_format (int aud_format)
     return SND_PCM_FORMAT_UNKNOWN;
 }
 
+/* picks the most precise integer format the device takes */
+static int find_int_format (snd_pcm_t * handle, snd_pcm_hw_params_t * params)
+{
+    static const int int_formats[] = {FMT_S32_NE, FMT_S24_NE, FMT_S24_3NE, FMT_S16_NE};
+
+    for (int format : int_formats)
+    {
+        if (! snd_pcm_hw_params_test_format (handle, params, convert_aud_format (format)))
+            return format;
+    }
+
+    return -1;
+}
+
 bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & error)
 {
     int total_buffer, hard_buffer, soft_buffer, buffer_frames;
@@ -338,6 +359,26 @@ bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & er
     CHECK_STR (error, snd_pcm_hw_params_set_access, alsa_handle, params,
      SND_PCM_ACCESS_RW_INTERLEAVED);
 
+    alsa_requantize = false;
+
+    if (aud_format == FMT_FLOAT &&
+     snd_pcm_hw_params_test_format (alsa_handle, params, format) < 0)
+    {
+        int int_format = find_int_format (alsa_handle, params);
+
+        if (int_format >= 0)
+        {
+            format = convert_aud_format (int_format);
+            AUDINFO ("Floating point is not supported; converting to %s.\n",
+             snd_pcm_format_name (format));
+
+            alsa_requantizer.start (int_format, channels, rate,
+             aud_get_int ("alsa", "dither"));
+            alsa_requantize = true;
+            alsa_sample_size = FMT_SIZEOF (int_format);
+        }
+    }
+
     CHECK_STR (error, snd_pcm_hw_params_set_format, alsa_handle, params, format);
     CHECK_STR (error, snd_pcm_hw_params_set_channels, alsa_handle, params, channels);
     CHECK_STR (error, snd_pcm_hw_params_set_rate, alsa_handle, params, rate, 0);
@@ -403,6 +444,7 @@ void ALSAPlugin::close_audio ()
 
 FAILED:
     alsa_buffer.destroy ();
+    alsa_converted.clear ();
     poll_cleanup ();
     snd_pcm_close (alsa_handle);
     alsa_handle = nullptr;
@@ -414,11 +456,30 @@ int ALSAPlugin::write_audio (const void * data, int length)
 {
     pthread_mutex_lock (& alsa_mutex);
 
-    length = aud::min (length, alsa_buffer.space ());
-    alsa_buffer.copy_in ((const char *) data, length);
+    int added;
+
+    if (alsa_requantize)
+    {
+        int samples = aud::min (length / (int) sizeof (float),
+         alsa_buffer.space () / alsa_sample_size);
+
+        alsa_converted.resize (samples * alsa_sample_size);
+        alsa_requantizer.process ((const float *) data, alsa_converted.begin (), samples);
+        alsa_buffer.copy_in (alsa_converted.begin (), alsa_converted.len ());
+
+        added = alsa_converted.len ();
+        length = samples * sizeof (float);
+    }
+    else
+    {
+        length = aud::min (length, alsa_buffer.space ());
+        alsa_buffer.copy_in ((const char *) data, length);
+
+        added = length;
+    }
 
     AUDDBG ("Buffer fill levels: low = %d%%, high = %d%%.\n",
-            (alsa_buffer.len () - length) * 100 / alsa_buffer.size (),
+            (alsa_buffer.len () - added) * 100 / alsa_buffer.size (),
             alsa_buffer.len () * 100 / alsa_buffer.size ());
 
     if (! alsa_prebuffer && ! alsa_paused)
@@ -514,6 +575,9 @@ void ALSAPlugin::flush ()
 FAILED:
     alsa_buffer.discard ();
 
+    if (alsa_requantize)
+        alsa_requantizer.flush ();
+
     alsa_prebuffer = true;
     alsa_paused_delay = 0;
 
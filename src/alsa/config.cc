@@ -23,6 +23,7 @@
 #include <libaudcore/preferences.h>
 
 #include "alsa.h"
+#include "../effect-common/dither.h"
 
 const char ALSAPlugin::about[] =
  N_("ALSA Output Plugin for Audacious\n"
@@ -241,6 +242,7 @@ static void guess_element ()
 const char * const ALSAPlugin::defaults[] = {
     "pcm", "default",
     "mixer", "default",
+    "dither", aud::numeric_string<DITHER_TPDF>::str,
     nullptr
 };
 
@@ -285,6 +287,13 @@ void ALSAPlugin::element_changed ()
     open_mixer ();
 }
 
+static const ComboItem dither_combo[] = {
+    ComboItem (N_("None"), DITHER_NONE),
+    ComboItem (N_("Triangular (TPDF)"), DITHER_TPDF),
+    ComboItem (N_("Noise shaped"), DITHER_SHAPED),
+    ComboItem (N_("Strongly noise shaped"), DITHER_SHAPED_STRONG)
+};
+
 static ArrayRef<ComboItem> pcm_combo_fill ()
     { return {pcm_combo_items.begin (), pcm_combo_items.len ()}; }
 static ArrayRef<ComboItem> mixer_combo_fill ()
@@ -301,7 +310,12 @@ const PreferencesWidget ALSAPlugin::widgets[] = {
         {nullptr, mixer_combo_fill}),
     WidgetCombo (N_("Mixer element:"),
         WidgetString ("alsa", "mixer-element", element_changed, "alsa mixer changed"),
-        {nullptr, element_combo_fill})
+        {nullptr, element_combo_fill}),
+    WidgetCombo (N_("Dithering:"),
+        WidgetInt ("alsa", "dither", pcm_changed),
+        {{dither_combo}}),
+    WidgetLabel (N_("<small>Dithering applies to floating point output on "
+     "devices without floating point support.</small>"))
 };
 
 static void alsa_prefs_init ()
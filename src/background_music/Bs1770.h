@@ -0,0 +1,312 @@
+#ifndef AUDACIOUS_PLUGINS_BGM_BS1770_H
+#define AUDACIOUS_PLUGINS_BGM_BS1770_H
+/*
+ * Background music (equal loudness) Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * Measures integrated loudness and true peak of an entire track as specified
+ * by ITU-R BS.1770-4 (and EBU R128): K-weighted mean squares over gating
+ * blocks of 400 ms with 75% overlap, an absolute gate at -70 LUFS and a
+ * relative gate 10 LU below the absolutely gated loudness. The true peak is
+ * measured after four times oversampling.
+ */
+class Bs1770Analyzer
+{
+    static constexpr int MAX_CHANNELS = 8;
+    static constexpr int STEPS_PER_BLOCK = 4;
+    static constexpr int TAPS_PER_PHASE = 12;
+    static constexpr int PHASES = 4;
+    static constexpr int PEAK_CHUNK = 1024;
+    static constexpr double LOUDNESS_OFFSET = -0.691;
+    static constexpr double ABSOLUTE_GATE = -70.0;
+    static constexpr double RELATIVE_GATE = -10.0;
+
+    /* Interpolation filter from BS.1770-4, Annex 2 */
+    static constexpr float oversampling_filter[PHASES][TAPS_PER_PHASE] = {
+        {0.0017089843750f, 0.0109863281250f, -0.0196533203125f,
+         0.0332031250000f, -0.0594482421875f, 0.1373291015625f,
+         0.9721679687500f, -0.1022949218750f, 0.0476074218750f,
+         -0.0266113281250f, 0.0148925781250f, -0.0083007812500f},
+        {-0.0291748046875f, 0.0292968750000f, -0.0517578125000f,
+         0.0891113281250f, -0.1665039062500f, 0.4650878906250f,
+         0.7797851562500f, -0.2003173828125f, 0.1015625000000f,
+         -0.0582275390625f, 0.0330810546875f, -0.0189208984375f},
+        {-0.0189208984375f, 0.0330810546875f, -0.0582275390625f,
+         0.1015625000000f, -0.2003173828125f, 0.7797851562500f,
+         0.4650878906250f, -0.1665039062500f, 0.0891113281250f,
+         -0.0517578125000f, 0.0292968750000f, -0.0291748046875f},
+        {-0.0083007812500f, 0.0148925781250f, -0.0266113281250f,
+         0.0476074218750f, -0.1022949218750f, 0.9721679687500f,
+         0.1373291015625f, -0.0594482421875f, 0.0332031250000f,
+         -0.0196533203125f, 0.0109863281250f, 0.0017089843750f}};
+
+    struct Biquad
+    {
+        double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    };
+
+    struct ChannelState
+    {
+        double shelf_1 = 0, shelf_2 = 0;
+        double high_pass_1 = 0, high_pass_2 = 0;
+        float history[TAPS_PER_PHASE - 1 + PEAK_CHUNK] = {};
+    };
+
+    Biquad shelf_;
+    Biquad high_pass_;
+    ChannelState state_[MAX_CHANNELS];
+    double weights_[MAX_CHANNELS] = {};
+    int channels_ = 0;
+    int step_frames_ = 0;
+
+    double step_sum_ = 0;
+    int step_count_ = 0;
+    double steps_[STEPS_PER_BLOCK] = {};
+    int steps_done_ = 0;
+    std::vector<double> blocks_;
+    float peak_ = 0;
+
+    static double filter(const Biquad & f, double & z1, double & z2,
+                         const double input)
+    {
+        /* transposed direct form II */
+        const double output = f.b0 * input + z1;
+        z1 = f.b1 * input - f.a1 * output + z2;
+        z2 = f.b2 * input - f.a2 * output;
+        return output;
+    }
+
+    static double to_loudness(const double mean_square)
+    {
+        return LOUDNESS_OFFSET + 10.0 * log10(mean_square);
+    }
+
+    void design_filters(const int rate)
+    {
+        /* stage 1: high shelf modelling the acoustic effect of the head */
+        double k = tan(M_PI * 1681.974450955533 / rate);
+        double q = 0.7071752369554196;
+        const double vh = pow(10.0, 3.999843853973347 / 20.0);
+        const double vb = pow(vh, 0.4996667741545416);
+        double a0 = 1.0 + k / q + k * k;
+        shelf_.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf_.b1 = 2.0 * (k * k - vh) / a0;
+        shelf_.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf_.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf_.a2 = (1.0 - k / q + k * k) / a0;
+
+        /* stage 2: RLB high-pass */
+        k = tan(M_PI * 38.13547087602444 / rate);
+        q = 0.5003270373238773;
+        a0 = 1.0 + k / q + k * k;
+        high_pass_.b0 = 1.0;
+        high_pass_.b1 = -2.0;
+        high_pass_.b2 = 1.0;
+        high_pass_.a1 = 2.0 * (k * k - 1.0) / a0;
+        high_pass_.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    void add_step()
+    {
+        steps_[steps_done_ % STEPS_PER_BLOCK] =
+            step_sum_ / static_cast<double>(step_frames_);
+        step_sum_ = 0;
+        step_count_ = 0;
+
+        if (++steps_done_ >= STEPS_PER_BLOCK)
+        {
+            double block = 0;
+            for (const double step : steps_)
+            {
+                block += step;
+            }
+            blocks_.push_back(block / STEPS_PER_BLOCK);
+        }
+    }
+
+    void measure_loudness(const float * data, const int frames)
+    {
+        for (int frame = 0; frame < frames; frame++)
+        {
+            const float * samples = data + frame * channels_;
+            double sum = 0;
+            for (int channel = 0; channel < channels_; channel++)
+            {
+                ChannelState & state = state_[channel];
+                double value = filter(shelf_, state.shelf_1, state.shelf_2,
+                                      samples[channel]);
+                value = filter(high_pass_, state.high_pass_1,
+                               state.high_pass_2, value);
+                sum += weights_[channel] * value * value;
+            }
+            step_sum_ += sum;
+            if (++step_count_ == step_frames_)
+            {
+                add_step();
+            }
+        }
+    }
+
+    void measure_peak(const float * data, const int frames)
+    {
+        float peak = peak_;
+        for (int channel = 0; channel < channels_; channel++)
+        {
+            float * history = state_[channel].history;
+            float * input = history + TAPS_PER_PHASE - 1;
+            for (int frame = 0; frame < frames; frame++)
+            {
+                input[frame] = data[frame * channels_ + channel];
+            }
+
+            for (const auto & phase : oversampling_filter)
+            {
+                for (int frame = 0; frame < frames; frame++)
+                {
+                    float value = 0;
+                    for (int tap = 0; tap < TAPS_PER_PHASE; tap++)
+                    {
+                        value += phase[tap] * input[frame - tap];
+                    }
+                    peak = std::max(peak, fabsf(value));
+                }
+            }
+
+            std::copy(input + frames - (TAPS_PER_PHASE - 1), input + frames,
+                      history);
+        }
+        peak_ = peak;
+    }
+
+public:
+    /**
+     * Prepares for a new track. Returns false if the format is not supported.
+     */
+    bool start(const int channels, const int rate)
+    {
+        if (channels < 1 || channels > MAX_CHANNELS || rate < 1)
+        {
+            return false;
+        }
+
+        channels_ = channels;
+        step_frames_ = std::max(1, rate / 10);
+        design_filters(rate);
+
+        /*
+         * Surround channels get a weight of 1.41 (+1.5 dB) and the LFE channel
+         * is not taken into account. This assumes the default channel order
+         * of 5.1 audio: front left, front right, center, LFE, rear left and
+         * rear right.
+         */
+        for (int channel = 0; channel < channels; channel++)
+        {
+            weights_[channel] = 1.0;
+        }
+        if (channels == 6)
+        {
+            weights_[3] = 0.0;
+            weights_[4] = weights_[5] = 1.41;
+        }
+
+        for (ChannelState & state : state_)
+        {
+            state = ChannelState();
+        }
+        step_sum_ = 0;
+        step_count_ = 0;
+        steps_done_ = 0;
+        blocks_.clear();
+        peak_ = 0;
+        return true;
+    }
+
+    /** Measures frames frames of interleaved samples. */
+    void process(const float * data, int frames)
+    {
+        measure_loudness(data, frames);
+
+        while (frames > 0)
+        {
+            const int chunk = std::min(frames, PEAK_CHUNK);
+            measure_peak(data, chunk);
+            data += chunk * channels_;
+            frames -= chunk;
+        }
+    }
+
+    /** Returns whether the track was long enough for a gated measurement. */
+    [[nodiscard]] bool has_loudness() const { return !blocks_.empty(); }
+
+    /** Returns the gated integrated loudness in LUFS. */
+    [[nodiscard]] double integrated_loudness() const
+    {
+        const double absolute_gate = to_mean_square(ABSOLUTE_GATE);
+        double sum = 0;
+        int count = 0;
+        for (const double block : blocks_)
+        {
+            if (block > absolute_gate)
+            {
+                sum += block;
+                count++;
+            }
+        }
+        if (!count)
+        {
+            return ABSOLUTE_GATE;
+        }
+
+        const double relative_gate =
+            sum / count * pow(10.0, RELATIVE_GATE / 10.0);
+        const double gate = std::max(absolute_gate, relative_gate);
+        sum = 0;
+        count = 0;
+        for (const double block : blocks_)
+        {
+            if (block > gate)
+            {
+                sum += block;
+                count++;
+            }
+        }
+
+        return count ? to_loudness(sum / count) : ABSOLUTE_GATE;
+    }
+
+    /** Returns the true peak in dBTP. */
+    [[nodiscard]] double true_peak() const
+    {
+        return 20.0 * log10(std::max(peak_, 1e-10f));
+    }
+
+    /**
+     * Converts a loudness in LUFS to the summed mean square of the K-weighted
+     * channels.
+     */
+    static double to_mean_square(const double loudness)
+    {
+        return pow(10.0, (loudness - LOUDNESS_OFFSET) / 10.0);
+    }
+};
+
+#endif // AUDACIOUS_PLUGINS_BGM_BS1770_H
@@ -19,15 +19,17 @@
  * the use of this software.
  */
 #include "LoudnessFrameProcessor.h"
+#include "TrackAnalysis.h"
+#include <libaudcore/drct.h>
 #include <libaudcore/plugin.h>
 
 class FrameBasedEffectPlugin : public EffectPlugin
 {
-    Index<float> frame_in;
-    Index<float> frame_out;
     Index<float> output;
-    int current_channels = 0, current_rate = 0, channel_last_read = 0;
+    int current_channels = 0, current_rate = 0;
     LoudnessFrameProcessor detection;
+    TrackAnalysis analysis;
+    bool analyze = false;
 
 public:
     FrameBasedEffectPlugin(const PluginInfo & info, int order)
@@ -40,67 +42,84 @@ public:
     bool init() override
     {
         detection.init();
+        analysis.init();
         return true;
     }
 
     void cleanup() override
     {
+        analysis.cleanup();
         output.clear();
-        frame_in.clear();
-        frame_out.clear();
     }
 
     void start(int & channels, int & rate) override
     {
         current_channels = channels;
         current_rate = rate;
-        channel_last_read = 0;
 
         detection.start(channels, rate);
-        frame_in.resize(current_channels);
-        frame_out.resize(current_channels);
 
         flush(false);
+
+        // Tracks that were measured before start out at the right level,
+        // others are measured while they play.
+        analyze = false;
+        if (!aud_get_bool(CONFIG_SECTION_BACKGROUND_MUSIC,
+                          CONF_TRACK_ANALYSIS_VARIABLE))
+        {
+            return;
+        }
+
+        String filename = aud_drct_get_filename();
+        float loudness;
+        if (!filename)
+        {
+            return;
+        }
+        if (analysis.lookup(filename, loudness))
+        {
+            detection.set_initial_loudness(loudness);
+        }
+        else
+        {
+            analysis.begin_track(filename, channels, rate);
+            analyze = true;
+        }
     }
 
     Index<float> & process(Index<float> & data) override
     {
         detection.update_config();
-
-        int output_samples = 0;
-        output.resize(0);
-
-        // It is assumed data always contains a multiple of channels, but we
-        // don't care.
-        for (const float sample : data)
+        if (analyze)
         {
-            frame_in[channel_last_read++] = sample;
-            if (channel_last_read == current_channels)
-            {
-                // Processing happens per frame. Because of read-ahead there is
-                // not always output available yet.
-                if (detection.process_has_output(frame_in, frame_out))
-                {
-                    output.move_from(frame_out, 0, output_samples,
-                                     current_channels, true, false);
-                    output_samples += current_channels;
-                }
-                channel_last_read = 0;
-            }
+            analysis.write(data.begin(), data.len());
         }
 
+        // It is assumed data always contains a multiple of channels. The
+        // output never has more frames than the input, but because of
+        // read-ahead there is not always output available yet.
+        const int frames = data.len() / current_channels;
+        output.resize(frames * current_channels);
+
+        const int written =
+            detection.process(data.begin(), output.begin(), frames);
+        output.resize(written * current_channels);
+
         return output;
     }
 
     bool flush(bool force) override
     {
         detection.flush();
+        analysis.abort_track();
         return true;
     }
 
     Index<float> & finish(Index<float> & data, bool end_of_playlist) override
     {
-        return process(data);
+        Index<float> & result = process(data);
+        analysis.end_track();
+        return result;
     }
 
     int adjust_delay(int delay) override
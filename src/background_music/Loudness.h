@@ -22,7 +22,7 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
-#include <libaudcore/ringbuf.h>
+#include <libaudcore/index.h>
 
 /**
  * Tools to detect perceived loudness.
@@ -77,48 +77,65 @@ struct Loudness
     }
 };
 
+/**
+ * Detects perceived loudness as the maximum of a number of weighted windowed
+ * averages of different lengths.
+ *
+ * Squared input is converted to integers, so that each windowed sum is exactly
+ * the difference of two prefix sums: P(t) - P(t - window length). Samples are
+ * processed in blocks: the prefix sums for a block are calculated first, and
+ * then every window is updated for the entire block in one loop, without
+ * dependencies between consecutive samples.
+ */
 class PerceptiveRMS
 {
     static constexpr int STEPS = 24;
+    static constexpr int BLOCK_SIZE = 256;
     static constexpr float INPUT_SCALE = 4e9f;
     static constexpr float OUTPUT_SCALE = 1.0f / INPUT_SCALE;
 
     class WindowedRMS
     {
-        uint64_t window_sum_ = 0;
         int window_size_ = 0;
-        int latency_minus_one = 0;
+        int length_ = 0;
         float scale_ = 0.0;
-        float output_ = 0.0;
 
     public:
-
-        float add_and_take_and_get(uint64_t add, uint64_t take)
+        /**
+         * Raises each of the frames values in maximum to the scaled windowed
+         * sum that ends at the corresponding prefix sum.
+         */
+        void add_maximum(const uint64_t * prefix, float * maximum,
+                         const int frames) const
         {
-            window_sum_ += add;
-            window_sum_ -= take;
-            const auto sum = static_cast<float>(window_sum_);
-            output_ = scale_ * sum;
-            return output_;
+            const uint64_t * delayed = prefix - length_;
+            const float scale = scale_;
+            for (int i = 0; i < frames; i++)
+            {
+                const auto sum = static_cast<float>(prefix[i] - delayed[i]);
+                maximum[i] = std::max(maximum[i], scale * sum);
+            }
         }
 
-        void configure(const Loudness::Metrics & metrics)
+        /**
+         * @param metrics The metrics for this window
+         * @param length The number of most recent samples to sum
+         */
+        void configure(const Loudness::Metrics & metrics, const int length)
         {
             window_size_ = metrics.window_samples;
-            latency_minus_one = std::max(0, metrics.latency_samples - 1);
+            length_ = length;
             scale_ = metrics.weight * metrics.weight /
                      static_cast<float>(window_size_);
-            window_sum_ = 0;
-            output_ = 0;
-        }
-
-        [[nodiscard]] int delayed_sample_index() const
-        {
-            return latency_minus_one;
         }
     };
 
-    RingBuf<uint64_t> buffer_;
+    /*
+     * The first latency_ elements contain the prefix sums of the previous
+     * samples, followed by room for a block of new ones.
+     */
+    Index<uint64_t> prefix_;
+    Index<float> maximum_;
     WindowedRMS rms_[STEPS + 1];
     int sample_rate_ = 0;
     int latency_ = 0;
@@ -132,10 +149,17 @@ class PerceptiveRMS
         smooth_release_.set_samples(max_metrics.window_samples,
                                     max_metrics.window_samples);
 
-        for (int step = 0; step <= STEPS; step++)
+        /*
+         * The longest window sums over the entire latency; the others lag one
+         * sample behind their latency.
+         */
+        rms_[0].configure(max_metrics, latency_);
+        for (int step = 1; step <= STEPS; step++)
         {
-            rms_[step].configure(
-                Loudness::get_metrics(step, STEPS, sample_rate_));
+            const auto metrics =
+                Loudness::get_metrics(step, STEPS, sample_rate_);
+            rms_[step].configure(metrics,
+                                 std::max(0, metrics.latency_samples - 1));
         }
     }
 
@@ -146,6 +170,35 @@ class PerceptiveRMS
             fabsf(std::round(squared_value * INPUT_SCALE)));
     }
 
+    void process_block(const float * squared_input, float * output,
+                       const int frames)
+    {
+        uint64_t * prefix = prefix_.begin() + latency_;
+        float * maximum = maximum_.begin();
+        uint64_t sum = prefix[-1];
+
+        for (int i = 0; i < frames; i++)
+        {
+            const uint64_t internal_value =
+                squared_value_to_internal_value(squared_input[i]);
+            sum += internal_value;
+            prefix[i] = sum;
+            maximum[i] = static_cast<float>(internal_value) * peak_weight_;
+        }
+
+        for (const WindowedRMS & rms : rms_)
+        {
+            rms.add_maximum(prefix, maximum, frames);
+        }
+
+        for (int i = 0; i < frames; i++)
+        {
+            output[i] = smooth_release_.get_envelope(maximum[i] * OUTPUT_SCALE);
+        }
+
+        std::copy(prefix + frames - latency_, prefix + frames, prefix_.begin());
+    }
+
 public:
     void set_rate_and_value(int sample_rate, float squared_initial_value)
     {
@@ -155,39 +208,44 @@ public:
         }
         sample_rate_ = sample_rate;
         init_detection();
-        buffer_.discard();
-        buffer_.alloc(latency_);
-        buffer_.fill_with(0);
+        prefix_.resize(latency_ + BLOCK_SIZE);
+        prefix_.erase(0, -1);
+        maximum_.resize(BLOCK_SIZE);
 
-        for (int i = 0; i <= latency_; i++)
+        float initial[BLOCK_SIZE];
+        std::fill(initial, initial + BLOCK_SIZE, squared_initial_value);
+        for (int done = 0; done <= latency_; done += BLOCK_SIZE)
         {
-            get_mean_squared(squared_initial_value);
+            const int frames = std::min(BLOCK_SIZE, latency_ + 1 - done);
+            process_block(initial, initial, frames);
+            std::fill(initial, initial + frames, squared_initial_value);
         }
     }
 
     [[nodiscard]] int latency() const { return latency_; }
 
-    float get_mean_squared(const float squared_input)
+    /**
+     * Makes the detection continue from a steady input with the given mean
+     * squared value.
+     */
+    void set_output(const float mean_squared)
     {
-        const uint64_t internal_value =
-            squared_value_to_internal_value(squared_input);
-        const uint64_t oldest = buffer_.pop();
-        buffer_.push(internal_value);
-
-        float max = rms_[0].add_and_take_and_get(internal_value, oldest);
-        max = std::max(max, static_cast<float>(internal_value) * peak_weight_);
+        smooth_release_.set_output(mean_squared);
+    }
 
-        for (int step = 1; step <= STEPS; step++)
+    /**
+     * Calculates the perceived mean squared value for each of the frames
+     * values in squared_input and writes them to output, which may be the same
+     * array.
+     */
+    void get_mean_squared(const float * squared_input, float * output,
+                          const int frames)
+    {
+        for (int done = 0; done < frames; done += BLOCK_SIZE)
         {
-            WindowedRMS & rms = rms_[step];
-            const auto delayed_input =
-                buffer_.nth_from_last(rms.delayed_sample_index());
-            const auto step_value =
-                rms.add_and_take_and_get(internal_value, delayed_input);
-            max = std::max(max, step_value);
+            process_block(squared_input + done, output + done,
+                          std::min(BLOCK_SIZE, frames - done));
         }
-        max *= OUTPUT_SCALE;
-        return smooth_release_.get_envelope(max);
     }
 };
 
@@ -18,10 +18,12 @@
  * implied. In no event shall the authors be liable for any damages arising from
  * the use of this software.
  */
+#include "Bs1770.h"
 #include "Integrator.h"
 #include "Loudness.h"
 #include "basic_config.h"
 #include <cmath>
+#include <libaudcore/ringbuf.h>
 #include <libaudcore/runtime.h>
 
 class LoudnessFrameProcessor
@@ -34,6 +36,7 @@ class LoudnessFrameProcessor
      */
     static constexpr float SLOW_VU_FUDGE_FACTOR = 2.0f;
     static constexpr float FAST_VU_FUDGE_FACTOR = 3.0f;
+    static constexpr int BLOCK_SIZE = 256;
 
     FastAttackSmoothRelease release_integration;
     Integrator long_integration;
@@ -46,6 +49,8 @@ class LoudnessFrameProcessor
     RingBuf<float> read_ahead_buffer;
     int channels_ = 0;
     int processed_frames = 0;
+    float square_sums[BLOCK_SIZE];
+    float gains[BLOCK_SIZE];
 
     static float get_clamped_value(const char * variable, const double minimum,
                                    const double maximum)
@@ -63,6 +68,67 @@ class LoudnessFrameProcessor
         return powf(10.0f, 0.05f * decibels);
     }
 
+    int process_block(const float * in, float * out, const int frames)
+    {
+        /*
+         * Until the read-ahead buffer is filled up, frames only go in. After
+         * that, every frame that goes in pushes out the frame that is
+         * latency() frames older.
+         */
+        const int skipped = std::min(frames, latency() - processed_frames);
+        const int written = frames - skipped;
+        processed_frames += skipped;
+        read_ahead_buffer.copy_in(in, frames * channels_);
+        read_ahead_buffer.move_out(out, written * channels_);
+
+        /*
+         * Following calculations need to happen to anticipate the (future)
+         * output.
+         */
+        for (int frame = 0; frame < frames; frame++)
+        {
+            const float * samples = in + frame * channels_;
+            float square_sum = 0.0;
+            float square_max = 0.0;
+            for (int channel = 0; channel < channels_; channel++)
+            {
+                const float square = samples[channel] * samples[channel];
+                square_max = std::max(square_max, square);
+                square_sum += square;
+            }
+            square_sum /= static_cast<float>(channels_);
+            square_sums[frame] = square_sum + square_max;
+        }
+
+        perceivedLoudness.get_mean_squared(square_sums, gains, frames);
+
+        for (int frame = 0; frame < frames; frame++)
+        {
+            const float perceived = FAST_VU_FUDGE_FACTOR * gains[frame];
+            const double weighted = std::max(
+                long_integration.integrate(square_sums[frame]), perceived);
+
+            const double rms = sqrt(weighted);
+
+            gains[frame] = target_level /
+                           std::max(minimum_detection,
+                                    static_cast<float>(
+                                        release_integration.get_envelope(rms)));
+        }
+
+        for (int frame = 0; frame < written; frame++)
+        {
+            const float gain = gains[skipped + frame];
+            float * samples = out + frame * channels_;
+            for (int channel = 0; channel < channels_; channel++)
+            {
+                samples[channel] *= gain;
+            }
+        }
+
+        return written;
+    }
+
 public:
     [[nodiscard]] int latency() const { return perceivedLoudness.latency(); }
 
@@ -97,7 +163,8 @@ public:
          * must therefore half the integration time.
          */
         perceivedLoudness.set_rate_and_value(rate, target_level);
-        const int alloc_size = channels_ * latency();
+        /* Room for the read-ahead and one block of new frames */
+        const int alloc_size = channels_ * (latency() + BLOCK_SIZE);
 
         if (read_ahead_buffer.size() < alloc_size)
         {
@@ -105,6 +172,29 @@ public:
         }
     }
 
+    /**
+     * Continues detection as if a track with the given integrated loudness in
+     * LUFS had already been playing for a while, so that the gain starts out
+     * right instead of settling during the first seconds.
+     */
+    void set_initial_loudness(const float loudness)
+    {
+        /*
+         * The mean square of all channels plus the maximum square, which is
+         * detected per frame, is on average about twice the mean square per
+         * channel.
+         */
+        const double square_sum = 2.0 *
+                                  Bs1770Analyzer::to_mean_square(loudness) /
+                                  static_cast<double>(channels_);
+        const double perceived = FAST_VU_FUDGE_FACTOR * square_sum;
+
+        perceivedLoudness.set_output(static_cast<float>(square_sum));
+        long_integration.set_output(slow_weight * square_sum);
+        release_integration.set_output(
+            sqrt(std::max(slow_weight * square_sum, perceived)));
+    }
+
     void update_config()
     {
         target_level = get_clamped_decibel_value(CONF_TARGET_LEVEL_VARIABLE,
@@ -122,56 +212,22 @@ public:
         long_integration.set_scale(slow_weight);
     }
 
-    bool process_has_output(const Index<float> & frame_in,
-                            Index<float> & frame_out)
+    /**
+     * Processes frames frames of interleaved samples from in and writes the
+     * frames that leave the read-ahead buffer to out, which must have room for
+     * the same number of frames. Returns the number of frames written, which
+     * is only less than frames while the read-ahead buffer fills up.
+     */
+    int process(const float * in, float * out, const int frames)
     {
-        bool has_output_data = processed_frames >= latency();
-        if (has_output_data)
+        int written = 0;
+        for (int done = 0; done < frames; done += BLOCK_SIZE)
         {
-            read_ahead_buffer.move_out(frame_out.begin(), channels_);
+            written += process_block(in + done * channels_,
+                                     out + written * channels_,
+                                     std::min(BLOCK_SIZE, frames - done));
         }
-        else
-        {
-            processed_frames++;
-        }
-        read_ahead_buffer.copy_in(frame_in.begin(), channels_);
-
-        /*
-         * Following calculations need to happen to anticipate the (future)
-         * output.
-         */
-
-        float square_sum = 0.0;
-        float square_max = 0.0;
-        for (const float sample : frame_in)
-        {
-            const float square = sample * sample;
-            square_max = std::max(square_max, square);
-            square_sum += square;
-        }
-        square_sum /= static_cast<float>(channels_);
-        square_sum += square_max;
-        const float perceived = FAST_VU_FUDGE_FACTOR *
-                                perceivedLoudness.get_mean_squared(square_sum);
-        const double weighted =
-            std::max(long_integration.integrate(square_sum), perceived);
-
-        const double rms = sqrt(weighted);
-
-        const float gain =
-            target_level /
-            std::max(minimum_detection,
-                     static_cast<float>(release_integration.get_envelope(rms)));
-
-        if (has_output_data)
-        {
-            for (float & sample : frame_out)
-            {
-                sample *= gain;
-            }
-        }
-
-        return has_output_data;
+        return written;
     }
 
     void flush()
@@ -0,0 +1,307 @@
+#ifndef AUDACIOUS_PLUGINS_BGM_TRACK_ANALYSIS_H
+#define AUDACIOUS_PLUGINS_BGM_TRACK_ANALYSIS_H
+/*
+ * Background music (equal loudness) Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+#include "Bs1770.h"
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <libaudcore/runtime.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Measures the loudness of complete tracks on a background thread while they
+ * play and remembers the results in a file in the user's configuration
+ * directory, keyed by the URI of the track.
+ *
+ * A track is only stored when it was played from start to end without
+ * seeking; otherwise the measurement is discarded.
+ */
+class TrackAnalysis
+{
+    /* More than this many seconds of audio waiting means the worker lags. */
+    static constexpr int MAX_QUEUED_SECONDS = 10;
+
+    struct Command
+    {
+        enum Type
+        {
+            Start,
+            Data,
+            Finish,
+            Abort
+        };
+
+        Type type;
+        std::string filename;
+        int channels = 0;
+        int rate = 0;
+        std::vector<float> data;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Command> queue_;
+    std::unordered_map<std::string, float> cache_;
+    std::thread thread_;
+    bool quit_ = false;
+    int queued_samples_ = 0;
+    int max_queued_samples_ = 0;
+    int channels_ = 0;
+    bool measuring_ = false;
+
+    static std::string cache_path()
+    {
+        return std::string(aud_get_path(AudPath::UserDir)) +
+               "/background_music_loudness";
+    }
+
+    void load_cache()
+    {
+        FILE * file = fopen(cache_path().c_str(), "r");
+        if (!file)
+        {
+            return;
+        }
+
+        /* Each line is: loudness <tab> true peak <tab> URI */
+        char * line = nullptr;
+        size_t size = 0;
+        ssize_t length;
+        while ((length = getline(&line, &size, file)) > 0)
+        {
+            if (line[length - 1] == '\n')
+            {
+                line[length - 1] = 0;
+            }
+
+            char * end;
+            const float loudness = strtof(line, &end);
+            if (end == line || *end != '\t')
+            {
+                continue;
+            }
+            strtof(end + 1, &end);
+            if (*end != '\t' || !end[1])
+            {
+                continue;
+            }
+            cache_[end + 1] = loudness;
+        }
+
+        free(line);
+        fclose(file);
+    }
+
+    void store(const std::string & filename, const double loudness,
+               const double peak)
+    {
+        AUDDBG("%s: %.2f LUFS, %.2f dBTP\n", filename.c_str(), loudness, peak);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cache_[filename] = static_cast<float>(loudness);
+        }
+
+        FILE * file = fopen(cache_path().c_str(), "a");
+        if (!file)
+        {
+            AUDWARN("Cannot write %s\n", cache_path().c_str());
+            return;
+        }
+        fprintf(file, "%.2f\t%.2f\t%s\n", loudness, peak, filename.c_str());
+        fclose(file);
+    }
+
+    void run()
+    {
+        Bs1770Analyzer analyzer;
+        std::string filename;
+        bool active = false;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            wake_.wait(lock, [this] { return quit_ || !queue_.empty(); });
+            if (quit_)
+            {
+                break;
+            }
+
+            Command command = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+
+            switch (command.type)
+            {
+            case Command::Start:
+                filename = std::move(command.filename);
+                active = analyzer.start(command.channels, command.rate);
+                break;
+            case Command::Data:
+                if (active)
+                {
+                    analyzer.process(command.data.data(),
+                                     static_cast<int>(command.data.size()) /
+                                         command.channels);
+                }
+                break;
+            case Command::Finish:
+                if (active && analyzer.has_loudness())
+                {
+                    store(filename, analyzer.integrated_loudness(),
+                          analyzer.true_peak());
+                }
+                active = false;
+                break;
+            case Command::Abort:
+                active = false;
+                break;
+            }
+
+            lock.lock();
+            if (command.type == Command::Data)
+            {
+                queued_samples_ -= static_cast<int>(command.data.size());
+            }
+        }
+    }
+
+    /* must be called with mutex_ locked */
+    void push(Command::Type type)
+    {
+        queue_.push_back({type});
+        wake_.notify_one();
+    }
+
+public:
+    void init()
+    {
+        load_cache();
+        quit_ = false;
+        thread_ = std::thread(&TrackAnalysis::run, this);
+    }
+
+    void cleanup()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+            wake_.notify_one();
+        }
+        thread_.join();
+
+        queue_.clear();
+        cache_.clear();
+        queued_samples_ = 0;
+        measuring_ = false;
+    }
+
+    /**
+     * Looks up the integrated loudness of a track that was measured before.
+     */
+    bool lookup(const char * filename, float & loudness)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = cache_.find(filename);
+        if (found == cache_.end())
+        {
+            return false;
+        }
+        loudness = found->second;
+        return true;
+    }
+
+    /**
+     * Starts measuring a track. Any track that was measured before is
+     * discarded, unless it was finished with end_track().
+     */
+    void begin_track(const char * filename, const int channels, const int rate)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (measuring_)
+        {
+            push(Command::Abort);
+        }
+
+        queue_.push_back({Command::Start, filename, channels, rate});
+        wake_.notify_one();
+        channels_ = channels;
+        max_queued_samples_ = MAX_QUEUED_SECONDS * channels * rate;
+        measuring_ = true;
+    }
+
+    /** Adds interleaved samples of the track to the measurement. */
+    void write(const float * data, const int samples)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!measuring_ || !samples)
+        {
+            return;
+        }
+
+        if (queued_samples_ + samples > max_queued_samples_)
+        {
+            AUDWARN("Loudness analysis cannot keep up, skipping track.\n");
+            push(Command::Abort);
+            measuring_ = false;
+            return;
+        }
+
+        /* Samples are added to the last command if it is still waiting. */
+        if (queue_.empty() || queue_.back().type != Command::Data)
+        {
+            push(Command::Data);
+            queue_.back().channels = channels_;
+        }
+
+        std::vector<float> & queued = queue_.back().data;
+        queued.insert(queued.end(), data, data + samples);
+        queued_samples_ += samples;
+    }
+
+    /** Completes the measurement and stores the result. */
+    void end_track()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (measuring_)
+        {
+            push(Command::Finish);
+            measuring_ = false;
+        }
+    }
+
+    /** Discards the measurement, for example after seeking. */
+    void abort_track()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (measuring_)
+        {
+            push(Command::Abort);
+            measuring_ = false;
+        }
+    }
+};
+
+#endif // AUDACIOUS_PLUGINS_BGM_TRACK_ANALYSIS_H
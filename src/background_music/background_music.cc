@@ -16,6 +16,7 @@
  * implied. In no event shall the authors be liable for any damages arising from
  * the use of this software.
  */
+#include "../effect-common/profiler.h"
 #include "FrameBasedEffectPlugin.h"
 #include <libaudcore/i18n.h>
 #include <libaudcore/preferences.h>
@@ -36,6 +37,9 @@ static constexpr const PreferencesWidget background_music_widgets[] = {
         N_("Slow detection weight:"),
         WidgetFloat(CONFIG_SECTION_BACKGROUND_MUSIC, CONF_SLOW_WEIGHT_VARIABLE),
         {CONF_SLOW_WEIGHT_MIN, CONF_SLOW_WEIGHT_MAX, 0.1}),
+    WidgetCheck(N_("Remember the loudness of played tracks"),
+                WidgetBool(CONFIG_SECTION_BACKGROUND_MUSIC,
+                           CONF_TRACK_ANALYSIS_VARIABLE)),
     WidgetLabel(N_("<b>Hint</b>")),
     WidgetLabel(
         N_("Slow detection weight is the relative weight\n"
@@ -57,7 +61,7 @@ static constexpr const char background_music_about[] =
        "changes sound natural without audible peaks, yet without lowering "
        "the volume before a peak in advance.");
 
-[[maybe_unused]] EXPORT FrameBasedEffectPlugin
+[[maybe_unused]] EXPORT PROFILED(FrameBasedEffectPlugin)
     aud_plugin_instance({N_("Background Music"), PACKAGE,
                          background_music_about, &background_music_preferences},
                         10);
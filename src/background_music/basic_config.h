@@ -38,6 +38,9 @@ static constexpr const char * CONF_SLOW_WEIGHT_DEFAULT_STRING = "0.5";
 static constexpr double CONF_SLOW_WEIGHT_MIN = 0.0;
 static constexpr double CONF_SLOW_WEIGHT_MAX = 2.0;
 
+static constexpr const char * CONF_TRACK_ANALYSIS_VARIABLE = "track_analysis";
+static constexpr const char * CONF_TRACK_ANALYSIS_DEFAULT_STRING = "TRUE";
+
 static constexpr const char * const background_music_defaults[] = {
     CONF_TARGET_LEVEL_VARIABLE, CONF_TARGET_LEVEL_DEFAULT_STRING,
     //
@@ -45,6 +48,8 @@ static constexpr const char * const background_music_defaults[] = {
     //
     CONF_SLOW_WEIGHT_VARIABLE, CONF_SLOW_WEIGHT_DEFAULT_STRING,
     //
+    CONF_TRACK_ANALYSIS_VARIABLE, CONF_TRACK_ANALYSIS_DEFAULT_STRING,
+    //
     nullptr};
 
 #endif // AUDACIOUS_PLUGINS_BGM_BASIC_CONFIG_H
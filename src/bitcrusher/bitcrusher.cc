@@ -24,6 +24,8 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/profiler.h"
+
 static const char * const bitcrusher_defaults[] = {
  "depth", "32",
  "downsample", "1.0",
@@ -66,7 +68,7 @@ private:
     Index<float> m_hold;
 };
 
-EXPORT Bitcrusher aud_plugin_instance;
+EXPORT PROFILED (Bitcrusher) aud_plugin_instance;
 
 bool
 Bitcrusher::init ()
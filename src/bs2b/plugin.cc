@@ -27,6 +27,8 @@
 
 #include <bs2b.h>
 
+#include "../effect-common/profiler.h"
+
 class BS2BPlugin : public EffectPlugin
 {
 public:
@@ -50,7 +52,7 @@ public:
     Index<float> & process (Index<float> & data) override;
 };
 
-EXPORT BS2BPlugin aud_plugin_instance;
+EXPORT PROFILED (BS2BPlugin) aud_plugin_instance;
 
 static t_bs2bdp bs2b = nullptr;
 static int bs2b_channels;
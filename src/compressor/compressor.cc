@@ -20,6 +20,7 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
@@ -27,27 +28,61 @@
 #include <libaudcore/ringbuf.h>
 #include <libaudcore/runtime.h>
 
+#include "../effect-common/dsp.h"
+#include "../effect-common/profiler.h"
+
 /* Response time adjustments.  Maybe this should be adjustable? */
 #define CHUNK_TIME 0.2f /* seconds */
 #define CHUNKS 5
 #define DECAY 0.3f
 
+/* Lookahead limiter settings.  The true peak is estimated by interpolating
+ * three extra points between each pair of samples (4x oversampling). */
+#define RELEASE_TIME 0.1f /* seconds */
+#define TP_TAPS 8
+#define TP_PHASES 3
+
+enum
+{
+    MODE_COMPRESSOR,
+    MODE_LIMITER
+};
+
 /* What is a "normal" volume?  Replay Gain stuff claims to use 89 dB, but what
  * does that translate to in our PCM range? */
 static const char * const compressor_defaults[] = {
     "center", "0.5",
     "range", "0.5",
+    "mode", "0", /* MODE_COMPRESSOR */
+    "lookahead", "5",
+    "ceiling", "-1",
      nullptr
 };
 
 static const PreferencesWidget compressor_widgets[] = {
+    WidgetLabel (N_("<b>Mode</b>")),
+    WidgetRadio (N_("Compressor"),
+        WidgetInt ("compressor", "mode"),
+        {MODE_COMPRESSOR}),
+    WidgetRadio (N_("Lookahead limiter"),
+        WidgetInt ("compressor", "mode"),
+        {MODE_LIMITER}),
     WidgetLabel (N_("<b>Compression</b>")),
     WidgetSpin (N_("Center volume:"),
         WidgetFloat ("compressor", "center"),
         {0.1, 1, 0.1}),
     WidgetSpin (N_("Dynamic range:"),
         WidgetFloat ("compressor", "range"),
-        {0.0, 3.0, 0.1})
+        {0.0, 3.0, 0.1}),
+    WidgetLabel (N_("<b>Limiter</b>")),
+    WidgetSpin (N_("Lookahead:"),
+        WidgetFloat ("compressor", "lookahead"),
+        {1, 10, 0.5, N_("ms")}),
+    WidgetSpin (N_("Ceiling:"),
+        WidgetFloat ("compressor", "ceiling"),
+        {-12, 0, 0.1, N_("dB")}),
+    WidgetLabel (N_("Mode and lookahead changes take effect\n"
+                    "at the start of the next song."))
 };
 
 static const PluginPreferences compressor_prefs = {{compressor_widgets}};
@@ -78,7 +113,7 @@ public:
     int adjust_delay (int delay) override;
 };
 
-EXPORT Compressor aud_plugin_instance;
+EXPORT PROFILED (Compressor) aud_plugin_instance;
 
 /* The read pointer of the ring buffer is kept aligned to the chunk size at all
  * times.  To preserve the alignment, each read from the buffer must either (a)
@@ -91,6 +126,28 @@ static int chunk_size;
 static float current_peak;
 static int current_channels, current_rate;
 
+/* In limiter mode, <buffer> is used as a delay line holding the last
+ * <lookahead> - 1 frames, which have not yet been assigned a gain.  The gain
+ * applied to each frame is the minimum gain needed for the next <lookahead>
+ * frames, found with a monotonic deque, and then averaged over <lookahead>
+ * frames (kept in <peaks>) so that it never changes abruptly. */
+
+struct LimiterPeak
+{
+    int64_t frame;
+    float gain;
+};
+
+static bool limiter;
+static int lookahead;
+static Index<LimiterPeak> deque;
+static int deque_head, deque_len;
+static int64_t frame_count;
+static double gain_sum;
+static float release_gain, release_step;
+static float tp_history[AUD_MAX_CHANNELS][TP_TAPS];
+static float tp_filter[TP_PHASES][TP_TAPS];
+
 /* I used to find the maximum sample and take that as the peak, but that doesn't
  * work well on badly clipped tracks.  Now, I use the highly sophisticated
  * method of averaging the absolute value of the samples and multiplying by 6, a
@@ -99,13 +156,7 @@ static int current_channels, current_rate;
 
 static float calc_peak (float * data, int length)
 {
-    float sum = 0;
-
-    float * end = data + length;
-    while (data < end)
-        sum += fabsf (* data ++);
-
-    return aud::max (0.01f, sum / length * 6);
+    return aud::max (0.01f, dsp_abs_sum (data, length) / length * 6);
 }
 
 static void do_ramp (float * data, int length, float peak_a, float peak_b)
@@ -115,16 +166,151 @@ static void do_ramp (float * data, int length, float peak_a, float peak_b)
     float a = powf (peak_a / center, range - 1);
     float b = powf (peak_b / center, range - 1);
 
-    for (int count = 0; count < length; count ++)
+    dsp_ramp (data, length, a, b);
+}
+
+static void build_tp_filter ()
+{
+    for (int p = 0; p < TP_PHASES; p ++)
     {
-        * data = (* data) * (a * (length - count) + b * count) / length;
-        data ++;
+        float sum = 0;
+
+        for (int k = 0; k < TP_TAPS; k ++)
+        {
+            /* interpolate between the 4th and 5th newest samples */
+            float d = (k - TP_TAPS / 2 + 1) - (p + 1) / (float) (TP_PHASES + 1);
+            float x = d / (TP_TAPS / 2);
+            float w = 0.42f + 0.5f * cosf (M_PI * x) + 0.08f * cosf (2 * M_PI * x);
+            float t = M_PI * d;
+
+            tp_filter[p][k] = sinf (t) / t * w;
+            sum += tp_filter[p][k];
+        }
+
+        for (int k = 0; k < TP_TAPS; k ++)
+            tp_filter[p][k] /= sum;
     }
 }
 
+/* Returns the peak of the newest frame, including inter-sample peaks.  The
+ * inter-sample peaks found are those of 3 frames earlier, which is close enough
+ * since the deque window covers those frames as well. */
+static float calc_true_peak (const float * frame)
+{
+    float peak = 0;
+
+    for (int c = 0; c < current_channels; c ++)
+    {
+        float * hist = tp_history[c];
+        memmove (hist, hist + 1, sizeof (float) * (TP_TAPS - 1));
+        hist[TP_TAPS - 1] = frame[c];
+
+        peak = aud::max (peak, fabsf (frame[c]));
+
+        for (int p = 0; p < TP_PHASES; p ++)
+        {
+            float sum = 0;
+            for (int k = 0; k < TP_TAPS; k ++)
+                sum += hist[k] * tp_filter[p][k];
+
+            peak = aud::max (peak, fabsf (sum));
+        }
+    }
+
+    return peak;
+}
+
+/* takes the newest frame and returns the gain for the oldest frame in the
+ * window, <lookahead> - 1 frames earlier */
+static float limiter_gain (const float * frame, float ceiling)
+{
+    float peak = calc_true_peak (frame);
+    float target = (peak > ceiling) ? ceiling / peak : 1.0f;
+
+    /* drop a peak that has left the window from the front first, so that the
+     * deque never holds more than <lookahead> entries */
+    if (deque_len && deque[deque_head].frame <= frame_count - lookahead)
+    {
+        deque_head = (deque_head + 1) % lookahead;
+        deque_len --;
+    }
+
+    /* drop peaks that are lower than the new one from the back of the deque */
+    while (deque_len && deque[(deque_head + deque_len - 1) % lookahead].gain >= target)
+        deque_len --;
+
+    deque[(deque_head + deque_len) % lookahead] = {frame_count, target};
+    deque_len ++;
+
+    float gain = aud::min (deque[deque_head].gain,
+     release_gain + (1.0f - release_gain) * release_step);
+
+    release_gain = gain;
+
+    if (peaks.len () == lookahead)
+    {
+        gain_sum -= peaks.head ();
+        peaks.pop ();
+    }
+
+    gain_sum += gain;
+    peaks.push (gain);
+
+    frame_count ++;
+
+    return gain_sum / lookahead;
+}
+
+static void limiter_process (const float * data, int length)
+{
+    float ceiling = powf (10, aud_get_double ("compressor", "ceiling") / 20);
+
+    while (length)
+    {
+        int writable = aud::min (length, buffer.space ());
+        int start = buffer.len () / current_channels;
+        int frames = writable / current_channels;
+
+        buffer.copy_in (data, writable);
+
+        data += writable;
+        length -= writable;
+
+        for (int f = 0; f < frames; f ++)
+        {
+            float gain = limiter_gain (& buffer[(start + f) * current_channels], ceiling);
+            int target = start + f - (lookahead - 1);
+
+            if (target >= 0)
+            {
+                for (int c = 0; c < current_channels; c ++)
+                    buffer[target * current_channels + c] *= gain;
+            }
+        }
+
+        int ready = buffer.len () / current_channels - (lookahead - 1);
+        if (ready > 0)
+            buffer.move_out (output, -1, ready * current_channels);
+    }
+}
+
+static void limiter_reset ()
+{
+    buffer.discard ();
+    peaks.discard ();
+
+    deque_head = deque_len = 0;
+    frame_count = 0;
+    gain_sum = 0;
+    release_gain = 1.0f;
+
+    memset (tp_history, 0, sizeof tp_history);
+}
+
 bool Compressor::init ()
 {
     aud_config_set_defaults ("compressor", compressor_defaults);
+    build_tp_filter ();
     return true;
 }
 
@@ -133,6 +319,7 @@ void Compressor::cleanup ()
     buffer.destroy ();
     peaks.destroy ();
     output.clear ();
+    deque.clear ();
 }
 
 void Compressor::start (int & channels, int & rate)
@@ -140,10 +327,28 @@ void Compressor::start (int & channels, int & rate)
     current_channels = channels;
     current_rate = rate;
 
-    chunk_size = channels * (int) (rate * CHUNK_TIME);
+    limiter = (aud_get_int ("compressor", "mode") == MODE_LIMITER);
 
-    buffer.alloc (chunk_size * CHUNKS);
-    peaks.alloc (CHUNKS);
+    if (limiter)
+    {
+        /* at least 5 frames are needed to cover the inter-sample peaks */
+        lookahead = aud::max (5, (int) (rate * aud_get_double ("compressor", "lookahead") / 1000));
+        release_step = 1.0f - expf (-1.0f / (rate * RELEASE_TIME));
+
+        /* twice the lookahead, so that each pass handles at least as many
+         * frames as are held back */
+        buffer.alloc (2 * lookahead * channels);
+        peaks.alloc (lookahead);
+
+        deque.resize (lookahead);
+    }
+    else
+    {
+        chunk_size = channels * (int) (rate * CHUNK_TIME);
+
+        buffer.alloc (chunk_size * CHUNKS);
+        peaks.alloc (CHUNKS);
+    }
 
     flush (true);
 }
@@ -152,6 +357,12 @@ Index<float> & Compressor::process (Index<float> & data)
 {
     output.resize (0);
 
+    if (limiter)
+    {
+        limiter_process (data.begin (), data.len ());
+        return output;
+    }
+
     int offset = 0;
     int remain = data.len ();
 
@@ -194,6 +405,12 @@ Index<float> & Compressor::process (Index<float> & data)
 
 bool Compressor::flush (bool force)
 {
+    if (limiter)
+    {
+        limiter_reset ();
+        return true;
+    }
+
     buffer.discard ();
     peaks.discard ();
 
@@ -205,6 +422,19 @@ Index<float> & Compressor::finish (Index<float> & data, bool end_of_playlist)
 {
     output.resize (0);
 
+    if (limiter)
+    {
+        limiter_process (data.begin (), data.len ());
+
+        /* push the held-back frames out with silence */
+        Index<float> silence;
+        silence.insert (0, buffer.len ());
+        limiter_process (silence.begin (), silence.len ());
+
+        limiter_reset ();
+        return output;
+    }
+
     peaks.discard ();
 
     while (buffer.len ())
@@ -0,0 +1,777 @@
+/*
+ * Convolution Reverb Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+/* The impulse response is split into two parts, each convolved with uniformly
+ * partitioned overlap-save convolution:
+ *
+ * The head (the first 2 * TAIL_BLOCK frames) uses short HEAD_BLOCK partitions
+ * and runs on the audio thread, which gives a latency of HEAD_BLOCK frames.
+ *
+ * The tail (everything after that) uses long TAIL_BLOCK partitions and runs on
+ * a worker thread.  Each block of TAIL_BLOCK input frames is handed to the
+ * worker as soon as it is complete, but its earliest contribution to the output
+ * is not needed until TAIL_BLOCK frames later, which gives the worker a full
+ * block period to finish.
+ *
+ * The worker thread also loads the impulse response and prepares the filters
+ * whenever the file or the stream format changes.  The audio thread passes the
+ * audio through unchanged in the meantime and swaps the new filters in once
+ * they are ready. */
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <sndfile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#define WANT_VFS_STDIO_COMPAT
+#include <libaudcore/i18n.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/runtime.h>
+#include <libaudcore/vfs.h>
+
+#include "../effect-common/fft.h"
+#include "../effect-common/profiler.h"
+
+#define HEAD_BLOCK 256
+#define TAIL_BLOCK 4096
+#define HEAD_LENGTH (2 * TAIL_BLOCK)
+#define MAX_IR_LENGTH 20 /* seconds */
+
+typedef RealFFT::Complex Complex;
+
+static const char convolver_about[] =
+ N_("Convolution Reverb Plugin for Audacious\n"
+    "Copyright 2026 Audacious developers\n\n"
+    "Applies a room or speaker impulse response, loaded from any file "
+    "format supported by libsndfile (such as WAV or FLAC).");
+
+static const char * const convolver_defaults[] = {
+    "ir_file", "",
+    "dry", "100",
+    "wet", "30",
+    nullptr
+};
+
+static void ir_changed ();
+
+static const PreferencesWidget convolver_widgets[] = {
+    WidgetLabel (N_("<b>Impulse Response</b>")),
+    WidgetFileEntry (nullptr,
+        WidgetString ("convolver", "ir_file", ir_changed),
+        {FileSelectMode::File}),
+    WidgetLabel (N_("<b>Mix</b>")),
+    WidgetSpin (N_("Dry:"),
+        WidgetInt ("convolver", "dry"),
+        {0, 100, 1, "%"}),
+    WidgetSpin (N_("Wet:"),
+        WidgetInt ("convolver", "wet"),
+        {0, 200, 1, "%"})
+};
+
+static const PluginPreferences convolver_prefs = {{convolver_widgets}};
+
+class Convolver : public EffectPlugin
+{
+public:
+    static constexpr PluginInfo info = {
+        N_("Convolution Reverb"),
+        PACKAGE,
+        convolver_about,
+        & convolver_prefs
+    };
+
+    constexpr Convolver () : EffectPlugin (info, 0, true) {}
+
+    bool init () override;
+    void cleanup () override;
+
+    void start (int & channels, int & rate) override;
+    Index<float> & process (Index<float> & data) override;
+    bool flush (bool force) override;
+    Index<float> & finish (Index<float> & data, bool end_of_playlist) override;
+    int adjust_delay (int delay) override;
+};
+
+EXPORT PROFILED (Convolver) aud_plugin_instance;
+
+/* one part of the impulse response, split into equal partitions and stored as
+ * spectra of 2 * <block> points (already scaled for the inverse FFT) */
+struct PartitionedFilter
+{
+    int block = 0, parts = 0;
+    Index<Complex> spectra;
+
+    void init (RealFFT & fft, const float * ir, int length, int block);
+};
+
+/* convolution state for one channel: the last 2 * <block> input frames and a
+ * frequency-domain delay line of the last <parts> input spectra */
+struct PartitionedState
+{
+    const PartitionedFilter * filter = nullptr;
+    Index<float> input, result;
+    Index<Complex> delay_line, accum;
+    int newest = 0;
+
+    void init (const PartitionedFilter & filter);
+    void reset ();
+    void process (RealFFT & fft, const float * in, float * out);
+};
+
+void PartitionedFilter::init (RealFFT & fft, const float * ir, int length, int block_)
+{
+    block = block_;
+    parts = (length + block - 1) / block;
+
+    int bins = block + 1;
+    float scale = 1.0f / (2 * block);
+
+    Index<float> padded;
+    padded.resize (2 * block);
+
+    spectra.resize (parts * bins);
+
+    for (int p = 0; p < parts; p ++)
+    {
+        int copy = aud::min (block, length - p * block);
+
+        padded.erase (0, -1);
+        for (int i = 0; i < copy; i ++)
+            padded[i] = ir[p * block + i] * scale;
+
+        fft.forward (padded.begin (), & spectra[p * bins]);
+    }
+}
+
+void PartitionedState::init (const PartitionedFilter & filter_)
+{
+    filter = & filter_;
+
+    int bins = filter->block + 1;
+
+    input.resize (2 * filter->block);
+    result.resize (2 * filter->block);
+    delay_line.resize (filter->parts * bins);
+    accum.resize (bins);
+
+    reset ();
+}
+
+void PartitionedState::reset ()
+{
+    input.erase (0, -1);
+    delay_line.erase (0, -1);
+    newest = 0;
+}
+
+void PartitionedState::process (RealFFT & fft, const float * in, float * out)
+{
+    int block = filter->block;
+    int parts = filter->parts;
+    int bins = block + 1;
+
+    /* overlap-save: transform the previous block followed by the new one */
+    std::copy (input.begin () + block, input.end (), input.begin ());
+    std::copy (in, in + block, input.begin () + block);
+
+    newest = (newest + parts - 1) % parts;
+    fft.forward (input.begin (), & delay_line[newest * bins]);
+
+    accum.erase (0, -1);
+
+    for (int p = 0; p < parts; p ++)
+    {
+        const Complex * x = & delay_line[((newest + p) % parts) * bins];
+        const Complex * h = & filter->spectra[p * bins];
+        Complex * acc = accum.begin ();
+
+        for (int k = 0; k < bins; k ++)
+            acc[k] += x[k] * h[k];
+    }
+
+    fft.inverse (accum.begin (), result.begin ());
+    std::copy (result.begin () + block, result.end (), out);
+}
+
+static std::atomic<bool> ir_dirty (true);
+
+static bool active;
+static int current_channels, current_rate;
+static int loaded_channels, loaded_rate;
+static bool load_waiting;
+static int response_frames;
+
+static RealFFT head_fft, tail_fft;
+static PartitionedFilter head_filters[AUD_MAX_CHANNELS], tail_filters[AUD_MAX_CHANNELS];
+static PartitionedState head_states[AUD_MAX_CHANNELS], tail_states[AUD_MAX_CHANNELS];
+static bool have_tail;
+
+/* planar, HEAD_BLOCK frames per channel; the dry signal is delayed by one
+ * block along with the wet one */
+static Index<float> block_in, block_dry, block_out;
+static int block_pos;
+
+/* planar, TAIL_BLOCK frames per channel */
+static Index<float> tail_in, tail_ready;
+static int tail_pos;
+static bool tail_submitted;
+
+/* interleaved, the last block of the previous song after a format change */
+static Index<float> pending;
+
+/* built by the worker thread, then swapped with the ones above */
+static Index<float> ir;
+static int ir_channels, ir_frames;
+static PartitionedFilter new_head_filters[AUD_MAX_CHANNELS], new_tail_filters[AUD_MAX_CHANNELS];
+static PartitionedState new_head_states[AUD_MAX_CHANNELS], new_tail_states[AUD_MAX_CHANNELS];
+
+/* shared with the worker thread, protected by <mutex> */
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_t worker;
+static bool worker_running, worker_quit, job_pending;
+static Index<float> job_in, job_out;
+static int load_serial, built_serial;  /* last requested and last built */
+static String load_uri;
+static int load_channels, load_rate;
+
+static void build_filters (const char * uri, int channels, int rate);
+
+static void * worker_thread (void *)
+{
+    pthread_mutex_lock (& mutex);
+
+    while (! worker_quit)
+    {
+        /* a newer request may come in while building; it replaces the
+         * result, which the audio thread has not taken yet */
+        if (built_serial != load_serial)
+        {
+            String uri = load_uri;
+            int channels = load_channels, rate = load_rate;
+            int serial = load_serial;
+
+            pthread_mutex_unlock (& mutex);
+
+            build_filters (uri, channels, rate);
+
+            pthread_mutex_lock (& mutex);
+
+            built_serial = serial;
+            continue;
+        }
+
+        if (! job_pending)
+        {
+            pthread_cond_wait (& cond, & mutex);
+            continue;
+        }
+
+        pthread_mutex_unlock (& mutex);
+
+        for (int c = 0; c < current_channels; c ++)
+            tail_states[c].process (tail_fft, & job_in[c * TAIL_BLOCK], & job_out[c * TAIL_BLOCK]);
+
+        pthread_mutex_lock (& mutex);
+
+        job_pending = false;
+        pthread_cond_broadcast (& cond);
+    }
+
+    pthread_mutex_unlock (& mutex);
+    return nullptr;
+}
+
+static void wait_for_worker ()
+{
+    pthread_mutex_lock (& mutex);
+
+    while (job_pending)
+        pthread_cond_wait (& cond, & mutex);
+
+    pthread_mutex_unlock (& mutex);
+}
+
+/* Virtual file access wrappers for libsndfile */
+static sf_count_t sf_get_filelen (void * user_data)
+{
+    return ((VFSFile *) user_data)->fsize ();
+}
+
+static sf_count_t sf_vseek (sf_count_t offset, int whence, void * user_data)
+{
+    if (((VFSFile *) user_data)->fseek (offset, to_vfs_seek_type (whence)) != 0)
+        return -1;
+
+    return ((VFSFile *) user_data)->ftell ();
+}
+
+static sf_count_t sf_vread (void * ptr, sf_count_t count, void * user_data)
+{
+    return ((VFSFile *) user_data)->fread (ptr, 1, count);
+}
+
+static sf_count_t sf_vwrite_dummy (const void * ptr, sf_count_t count, void * user_data)
+{
+    return 0;
+}
+
+static sf_count_t sf_tell (void * user_data)
+{
+    return ((VFSFile *) user_data)->ftell ();
+}
+
+static SF_VIRTUAL_IO sf_virtual_io = {
+    sf_get_filelen,
+    sf_vseek,
+    sf_vread,
+    sf_vwrite_dummy,
+    sf_tell
+};
+
+/* loads the impulse response, converted to <rate> and normalized so that the
+ * loudest channel has unit energy */
+static bool load_ir (const char * uri, int rate)
+{
+    ir.clear ();
+    ir_channels = ir_frames = 0;
+
+    if (! uri[0])
+        return false;
+
+    VFSFile file (uri, "r");
+    if (! file)
+    {
+        AUDERR ("Failed to open %s: %s.\n", uri, file.error ());
+        return false;
+    }
+
+    SF_INFO info {};  // must be zeroed before sf_open()
+    SNDFILE * sndfile = sf_open_virtual (& sf_virtual_io, SFM_READ, & info, & file);
+
+    if (! sndfile)
+    {
+        AUDERR ("Failed to read %s: %s.\n", uri, sf_strerror (nullptr));
+        return false;
+    }
+
+    int frames = aud::min (info.frames, (sf_count_t) info.samplerate * MAX_IR_LENGTH);
+
+    Index<float> raw;
+    raw.resize (frames * info.channels);
+    frames = sf_readf_float (sndfile, raw.begin (), frames);
+
+    sf_close (sndfile);
+
+    if (frames <= 0 || info.channels < 1)
+        return false;
+
+    /* convert the sample rate by linear interpolation, which is good enough
+     * for the diffuse content of a typical impulse response */
+    ir_channels = aud::min (info.channels, AUD_MAX_CHANNELS);
+    ir_frames = (int64_t) frames * rate / info.samplerate;
+    ir.resize (ir_channels * ir_frames);
+
+    for (int f = 0; f < ir_frames; f ++)
+    {
+        double pos = (double) f * info.samplerate / rate;
+        int i0 = aud::min ((int) pos, frames - 1);
+        int i1 = aud::min (i0 + 1, frames - 1);
+        float t = pos - i0;
+
+        for (int c = 0; c < ir_channels; c ++)
+        {
+            float a = raw[i0 * info.channels + c];
+            float b = raw[i1 * info.channels + c];
+            ir[c * ir_frames + f] = a + (b - a) * t;
+        }
+    }
+
+    float max_energy = 0;
+
+    for (int c = 0; c < ir_channels; c ++)
+    {
+        float energy = 0;
+        for (int f = 0; f < ir_frames; f ++)
+            energy += ir[c * ir_frames + f] * ir[c * ir_frames + f];
+
+        max_energy = aud::max (max_energy, energy);
+    }
+
+    if (max_energy <= 0)
+        return false;
+
+    float scale = 1.0f / sqrtf (max_energy);
+    for (float & s : ir)
+        s *= scale;
+
+    return true;
+}
+
+/* worker thread: loads the impulse response and prepares new filters and
+ * convolution states for <channels> channels at <rate> */
+static void build_filters (const char * uri, int channels, int rate)
+{
+    load_ir (uri, rate);
+
+    for (int c = 0; c < ir_channels; c ++)
+    {
+        const float * data = & ir[c * ir_frames];
+        int head_length = aud::min (ir_frames, HEAD_LENGTH);
+
+        new_head_filters[c].init (head_fft, data, head_length, HEAD_BLOCK);
+
+        if (ir_frames > HEAD_LENGTH)
+            new_tail_filters[c].init (tail_fft, data + HEAD_LENGTH,
+             ir_frames - HEAD_LENGTH, TAIL_BLOCK);
+    }
+
+    if (! ir_frames)
+        return;
+
+    for (int c = 0; c < channels; c ++)
+    {
+        new_head_states[c].init (new_head_filters[c % ir_channels]);
+        if (ir_frames > HEAD_LENGTH)
+            new_tail_states[c].init (new_tail_filters[c % ir_channels]);
+    }
+}
+
+static void reset_state ()
+{
+    wait_for_worker ();
+
+    for (int c = 0; c < current_channels; c ++)
+    {
+        head_states[c].reset ();
+        if (have_tail)
+            tail_states[c].reset ();
+    }
+
+    block_in.erase (0, -1);
+    block_dry.erase (0, -1);
+    block_out.erase (0, -1);
+    tail_in.erase (0, -1);
+    tail_ready.erase (0, -1);
+
+    block_pos = 0;
+    tail_pos = 0;
+    tail_submitted = false;
+}
+
+/* asks the worker thread for new filters; the audio passes through unchanged
+ * until they are ready */
+static void request_load ()
+{
+    wait_for_worker ();
+
+    pthread_mutex_lock (& mutex);
+
+    load_uri = aud_get_str ("convolver", "ir_file");
+    load_channels = current_channels;
+    load_rate = current_rate;
+    load_serial ++;
+    pthread_cond_broadcast (& cond);
+
+    pthread_mutex_unlock (& mutex);
+
+    loaded_channels = current_channels;
+    loaded_rate = current_rate;
+    load_waiting = true;
+    active = false;
+}
+
+/* swaps in the filters built by the worker thread, if they are ready */
+static void check_load ()
+{
+    pthread_mutex_lock (& mutex);
+
+    bool ready = (built_serial == load_serial);
+
+    pthread_mutex_unlock (& mutex);
+
+    if (! ready)
+        return;
+
+    load_waiting = false;
+    active = (ir_frames > 0);
+    have_tail = (ir_frames > HEAD_LENGTH);
+    response_frames = ir_frames;
+
+    if (! active)
+        return;
+
+    for (int c = 0; c < ir_channels; c ++)
+    {
+        std::swap (head_filters[c], new_head_filters[c]);
+        if (have_tail)
+            std::swap (tail_filters[c], new_tail_filters[c]);
+    }
+
+    for (int c = 0; c < current_channels; c ++)
+    {
+        std::swap (head_states[c], new_head_states[c]);
+        head_states[c].filter = & head_filters[c % ir_channels];
+
+        if (have_tail)
+        {
+            std::swap (tail_states[c], new_tail_states[c]);
+            tail_states[c].filter = & tail_filters[c % ir_channels];
+        }
+    }
+
+    reset_state ();
+}
+
+static void ir_changed ()
+{
+    ir_dirty = true;
+}
+
+bool Convolver::init ()
+{
+    aud_config_set_defaults ("convolver", convolver_defaults);
+
+    head_fft.init (2 * HEAD_BLOCK);
+    tail_fft.init (2 * TAIL_BLOCK);
+
+    worker_quit = false;
+    worker_running = ! pthread_create (& worker, nullptr, worker_thread, nullptr);
+
+    if (! worker_running)
+    {
+        AUDERR ("Failed to create worker thread.\n");
+        return false;
+    }
+
+    ir_dirty = true;
+    return true;
+}
+
+void Convolver::cleanup ()
+{
+    pthread_mutex_lock (& mutex);
+    worker_quit = true;
+    pthread_cond_broadcast (& cond);
+    pthread_mutex_unlock (& mutex);
+
+    pthread_join (worker, nullptr);
+    worker_running = false;
+    job_pending = false;
+    load_serial = built_serial = 0;
+    load_uri = String ();
+
+    ir.clear ();
+    block_in.clear ();
+    block_dry.clear ();
+    block_out.clear ();
+    tail_in.clear ();
+    tail_ready.clear ();
+    job_in.clear ();
+    job_out.clear ();
+    pending.clear ();
+
+    loaded_channels = 0;
+    loaded_rate = 0;
+    load_waiting = false;
+    active = false;
+}
+
+/* hands the completed tail block to the worker, first collecting the result of
+ * the previous one, which is needed from now on */
+static void submit_tail ()
+{
+    pthread_mutex_lock (& mutex);
+
+    while (job_pending)
+        pthread_cond_wait (& cond, & mutex);
+
+    if (tail_submitted)
+        std::swap (tail_ready, job_out);
+
+    std::swap (tail_in, job_in);
+
+    tail_submitted = true;
+    job_pending = true;
+    pthread_cond_broadcast (& cond);
+
+    pthread_mutex_unlock (& mutex);
+}
+
+static void process_block ()
+{
+    for (int c = 0; c < current_channels; c ++)
+    {
+        float * in = & block_in[c * HEAD_BLOCK];
+        float * out = & block_out[c * HEAD_BLOCK];
+
+        head_states[c].process (head_fft, in, out);
+
+        if (have_tail)
+        {
+            const float * tail = & tail_ready[c * TAIL_BLOCK + tail_pos];
+            for (int i = 0; i < HEAD_BLOCK; i ++)
+                out[i] += tail[i];
+
+            std::copy (in, in + HEAD_BLOCK, & tail_in[c * TAIL_BLOCK + tail_pos]);
+        }
+    }
+
+    std::swap (block_in, block_dry);
+
+    if (have_tail)
+    {
+        tail_pos += HEAD_BLOCK;
+
+        if (tail_pos == TAIL_BLOCK)
+        {
+            submit_tail ();
+            tail_pos = 0;
+        }
+    }
+}
+
+static void run (float * data, int samples)
+{
+    float dry = aud_get_int ("convolver", "dry") / 100.0f;
+    float wet = aud_get_int ("convolver", "wet") / 100.0f;
+
+    float * end = data + samples;
+
+    while (data < end)
+    {
+        for (int c = 0; c < current_channels; c ++)
+        {
+            int i = c * HEAD_BLOCK + block_pos;
+
+            block_in[i] = data[c];
+            data[c] = block_dry[i] * dry + block_out[i] * wet;
+        }
+
+        data += current_channels;
+
+        if (++ block_pos == HEAD_BLOCK)
+        {
+            process_block ();
+            block_pos = 0;
+        }
+    }
+}
+
+/* at a format change, pushes the last block of the previous song out with
+ * silence; it is output before the first block of the next one */
+static void drain_block (int new_channels)
+{
+    int old_channels = current_channels;
+
+    Index<float> silence;
+    silence.insert (0, old_channels * HEAD_BLOCK);
+    run (silence.begin (), silence.len ());
+
+    pending.resize (new_channels * HEAD_BLOCK);
+
+    for (int f = 0; f < HEAD_BLOCK; f ++)
+    {
+        for (int c = 0; c < new_channels; c ++)
+            pending[f * new_channels + c] = silence[f * old_channels + c % old_channels];
+    }
+}
+
+void Convolver::start (int & channels, int & rate)
+{
+    if (active && (channels != current_channels || rate != current_rate))
+        drain_block (channels);
+
+    wait_for_worker ();
+
+    current_channels = channels;
+    current_rate = rate;
+
+    block_in.resize (channels * HEAD_BLOCK);
+    block_dry.resize (channels * HEAD_BLOCK);
+    block_out.resize (channels * HEAD_BLOCK);
+    tail_in.resize (channels * TAIL_BLOCK);
+    tail_ready.resize (channels * TAIL_BLOCK);
+    job_in.resize (channels * TAIL_BLOCK);
+    job_out.resize (channels * TAIL_BLOCK);
+
+    if (ir_dirty.exchange (false) || load_waiting ||
+     channels != loaded_channels || rate != loaded_rate)
+        request_load ();
+    else if (active)
+        reset_state ();
+}
+
+Index<float> & Convolver::process (Index<float> & data)
+{
+    if (ir_dirty.exchange (false))
+        request_load ();
+    if (load_waiting)
+        check_load ();
+
+    if (active)
+        run (data.begin (), data.len ());
+
+    if (pending.len ())
+    {
+        data.insert (pending.begin (), 0, pending.len ());
+        pending.clear ();
+    }
+
+    return data;
+}
+
+bool Convolver::flush (bool force)
+{
+    pending.clear ();
+
+    if (active)
+        reset_state ();
+
+    return true;
+}
+
+Index<float> & Convolver::finish (Index<float> & data, bool end_of_playlist)
+{
+    if (! end_of_playlist)
+        return process (data);
+
+    if (load_waiting)
+        check_load ();
+
+    /* at the end of the playlist, push out the last block and the whole
+     * reverb tail with silence */
+    if (active)
+        data.insert (-1, current_channels * (HEAD_BLOCK + response_frames));
+
+    return process (data);
+}
+
+int Convolver::adjust_delay (int delay)
+{
+    if (! active)
+        return delay;
+
+    return delay + aud::rescale (HEAD_BLOCK, current_rate, 1000);
+}
@@ -18,11 +18,16 @@
  */
 
 #include <math.h>
+#include <atomic>
+
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 #include <libaudcore/runtime.h>
 
+#include "../effect-common/dsp.h"
+#include "../effect-common/profiler.h"
+
 enum
 {
     STATE_OFF,
@@ -32,13 +37,23 @@ enum
     STATE_FLUSHED
 };
 
+enum
+{
+    CURVE_LINEAR,
+    CURVE_SIGMOID,
+    CURVE_EQUAL_POWER
+};
+
+/* number of linear segments the fade curve is approximated with */
+#define CURVE_STEPS 1024
+
 static const char * const crossfade_defaults[] = {
     "automatic", "TRUE",
     "length", "5",
     "manual", "TRUE",
     "manual_length", "0.2",
     "no_fade_in", "FALSE",
-    "use_sigmoid", "FALSE",
+    "curve", "0", /* CURVE_LINEAR */
     "sigmoid_steepness", "6",
     nullptr
 };
@@ -47,6 +62,8 @@ static const char crossfade_about[] =
  N_("Crossfade Plugin for Audacious\n"
     "Copyright 2010-2014 John Lindgren");
 
+static void curve_changed ();
+
 static const PreferencesWidget crossfade_widgets[] = {
     WidgetLabel (N_("<b>Crossfade</b>")),
     WidgetCheck (N_("On automatic song change"),
@@ -63,12 +80,20 @@ static const PreferencesWidget crossfade_widgets[] = {
         WIDGET_CHILD),
     WidgetCheck (N_("No fade in"),
         WidgetBool ("crossfade", "no_fade_in")),
-    WidgetCheck (N_("Use S-curve fade"),
-        WidgetBool ("crossfade", "use_sigmoid")),
-    WidgetSpin (N_("S-curve steepness:"),
-        WidgetFloat ("crossfade", "sigmoid_steepness"),
+    WidgetLabel (N_("<b>Fade Curve</b>")),
+    WidgetRadio (N_("Linear"),
+        WidgetInt ("crossfade", "curve", curve_changed),
+        {CURVE_LINEAR}),
+    WidgetRadio (N_("S-curve"),
+        WidgetInt ("crossfade", "curve", curve_changed),
+        {CURVE_SIGMOID}),
+    WidgetSpin (N_("Steepness:"),
+        WidgetFloat ("crossfade", "sigmoid_steepness", curve_changed),
         {2.0, 16.0, 0.5, N_("(higher is steeper)")},
         WIDGET_CHILD),
+    WidgetRadio (N_("Equal power"),
+        WidgetInt ("crossfade", "curve", curve_changed),
+        {CURVE_EQUAL_POWER}),
     WidgetLabel (N_("<b>Tip</b>")),
     WidgetLabel (N_("For better crossfading, enable\n"
                     "the Silence Removal effect."))
@@ -99,16 +124,32 @@ public:
     int adjust_delay (int delay) override;
 };
 
-EXPORT Crossfade aud_plugin_instance;
+EXPORT PROFILED (Crossfade) aud_plugin_instance;
 
 static char state = STATE_OFF;
 static int current_channels, current_rate;
 static Index<float> buffer, output;
 static int fadein_point;
 
+/* fade-in gain at CURVE_STEPS + 1 evenly spaced points; the fade-out gain is
+ * the same curve read backwards */
+static float curve[CURVE_STEPS + 1];
+static std::atomic<bool> curve_dirty (true);
+
+static void cancel_conversion ();
+
 bool Crossfade::init ()
 {
     aud_config_set_defaults ("crossfade", crossfade_defaults);
+
+    /* migrate the old S-curve setting */
+    if (aud_get_bool ("crossfade", "use_sigmoid"))
+    {
+        aud_set_int ("crossfade", "curve", CURVE_SIGMOID);
+        aud_set_bool ("crossfade", "use_sigmoid", false);
+    }
+
+    curve_dirty = true;
     return true;
 }
 
@@ -117,65 +158,276 @@ void Crossfade::cleanup ()
     state = STATE_OFF;
     buffer.clear ();
     output.clear ();
+    cancel_conversion ();
 }
 
-static void do_linear_ramp (float * data, int length, float a, float b)
+/* called from the main thread; the table itself is only ever touched by the
+ * audio thread, which rebuilds it before the next fade */
+static void curve_changed ()
 {
-    for (int i = 0; i < length; i ++)
-        (* data ++) *= (a * (length - i) + b * i) / length;
+    curve_dirty = true;
 }
 
-static void do_sigmoid_ramp (float * data, int length, float a, float b)
+static void build_curve ()
 {
+    int type = aud_get_int ("crossfade", "curve");
     float steepness = aud_get_double ("crossfade", "sigmoid_steepness");
-    for (int i = 0; i < length; i ++)
+
+    /* scale the S-curve so that it reaches exactly 0 and 1 at the ends */
+    float sigmoid_scale = 1.0f / tanhf (steepness * 0.5f);
+
+    for (int i = 0; i <= CURVE_STEPS; i ++)
     {
-        float linear = (a * (length - i) + b * i) / length;
-        (* data ++) *= 0.5f + 0.5f * tanhf (steepness * (linear - 0.5f));
+        float x = (float) i / CURVE_STEPS;
+
+        switch (type)
+        {
+        case CURVE_SIGMOID:
+            curve[i] = 0.5f + 0.5f * sigmoid_scale * tanhf (steepness * (x - 0.5f));
+            break;
+        case CURVE_EQUAL_POWER:
+            curve[i] = sinf (x * (float) M_PI_2);
+            break;
+        default:
+            curve[i] = x;
+            break;
+        }
     }
+
+    curve[0] = 0.0f;
+    curve[CURVE_STEPS] = 1.0f;
+}
+
+static void update_curve ()
+{
+    if (curve_dirty.exchange (false))
+        build_curve ();
 }
 
+/* gain at table position <p> (in units of CURVE_STEPS), interpolated along
+ * segment <seg> even if <p> lies slightly outside of it */
+static float curve_at (int seg, double p)
+{
+    return curve[seg] + (curve[seg + 1] - curve[seg]) * (float) (p - seg);
+}
+
+/* Multiplies data by the fade curve, evaluated at a position ramping linearly
+ * from <a> to <b> (0 = silent, 1 = full volume).  Between two table points the
+ * curve is linear, so each segment is applied as a single vectorized ramp. */
 static void do_ramp (float * data, int length, float a, float b)
 {
-    if (aud_get_bool ("crossfade", "use_sigmoid"))
-        do_sigmoid_ramp (data, length, a, b);
-    else
-        do_linear_ramp (data, length, a, b);
+    if (length <= 0)
+        return;
+
+    double start = a * (double) CURVE_STEPS;
+    double slope = (b - a) * (double) CURVE_STEPS / length;
+
+    int i = 0;
+    while (i < length)
+    {
+        double p = start + slope * i;
+        int seg, end;
+
+        if (slope > 0)
+        {
+            seg = aud::clamp ((int) floor (p), 0, CURVE_STEPS - 1);
+            end = (seg == CURVE_STEPS - 1) ? length : (int) ceil ((seg + 1 - start) / slope);
+        }
+        else if (slope < 0)
+        {
+            seg = aud::clamp ((int) ceil (p) - 1, 0, CURVE_STEPS - 1);
+            end = (seg == 0) ? length : (int) ceil ((seg - start) / slope);
+        }
+        else
+        {
+            seg = aud::clamp ((int) floor (p), 0, CURVE_STEPS - 1);
+            end = length;
+        }
+
+        end = aud::clamp (end, i + 1, length);
+
+        dsp_ramp (data + i, end - i, curve_at (seg, p), curve_at (seg, start + slope * end));
+        i = end;
+    }
+}
+
+/* When the format changes in the middle of a crossfade, the buffered tail of
+ * the previous song is resampled with a windowed-sinc filter.  The filter is
+ * stored as a table of PHASES + 1 sub-sample offsets of TAPS coefficients each;
+ * coefficients for offsets in between are interpolated linearly.
+ *
+ * The conversion itself is done in pieces, as the buffer is consumed by the
+ * fade-in, rather than all at once when the new song starts. */
+#define TAPS 32
+#define PHASES 256
+
+static float filter[(PHASES + 1) * TAPS];
+static float filter_cutoff;
+
+/* the buffer as it was before the format change, stored planar with TAPS / 2
+ * samples of padding at each end of each channel */
+static Index<float> source;
+static int source_channels, source_rate, source_stride;
+static int source_map[AUD_MAX_CHANNELS];
+
+static int convert_frames, converted_frames;
+static bool converting, fadeout_pending;
+
+static void build_filter (float cutoff)
+{
+    if (cutoff == filter_cutoff)
+        return;
+
+    for (int p = 0; p <= PHASES; p ++)
+    {
+        float * row = & filter[p * TAPS];
+        float sum = 0;
+
+        for (int k = 0; k < TAPS; k ++)
+        {
+            /* distance from the interpolated point to this tap */
+            double d = (k - TAPS / 2 + 1) - (double) p / PHASES;
+            double x = d / (TAPS / 2);
+            double w = (fabs (x) < 1) ? 0.42 + 0.5 * cos (M_PI * x) + 0.08 * cos (2 * M_PI * x) : 0;
+            double t = M_PI * cutoff * d;
+            double h = (t == 0) ? 1 : sin (t) / t;
+
+            row[k] = h * w;
+            sum += row[k];
+        }
+
+        for (int k = 0; k < TAPS; k ++)
+            row[k] /= sum;
+    }
+
+    filter_cutoff = cutoff;
+}
+
+static void convert_range (int f0, int f1)
+{
+    float coefs[TAPS];
+
+    for (int f = f0; f < f1; f ++)
+    {
+        int64_t pos = (int64_t) f * source_rate;
+        int in = pos / current_rate;
+        float phase = (float) (pos % current_rate) * PHASES / current_rate;
+        int ph = aud::min ((int) phase, PHASES - 1);
+        float t = phase - ph;
+
+        const float * c0 = & filter[ph * TAPS];
+        const float * c1 = c0 + TAPS;
+
+        for (int k = 0; k < TAPS; k ++)
+            coefs[k] = c0[k] + (c1[k] - c0[k]) * t;
+
+        float * out = & buffer[f * current_channels];
+
+        for (int c = 0; c < current_channels; c ++)
+        {
+            const float * x = & source[source_map[c] * source_stride + in + 1];
+            float sum = 0;
+
+            for (int k = 0; k < TAPS; k ++)
+                sum += x[k] * coefs[k];
+
+            out[c] = sum;
+        }
+    }
+}
+
+/* converts the buffer up to at least sample <needed> */
+static void convert_up_to (int needed)
+{
+    if (! converting)
+        return;
+
+    int f0 = converted_frames;
+    int f1 = aud::min (convert_frames, (needed + current_channels - 1) / current_channels);
+
+    if (f1 > f0)
+    {
+        convert_range (f0, f1);
+
+        if (fadeout_pending)
+        {
+            float a = 1.0f - (float) f0 / convert_frames;
+            float b = 1.0f - (float) f1 / convert_frames;
+            do_ramp (& buffer[f0 * current_channels], (f1 - f0) * current_channels, a, b);
+        }
+
+        converted_frames = f1;
+    }
+
+    if (converted_frames == convert_frames)
+    {
+        converting = false;
+        source.clear ();
+    }
+}
+
+static void finish_conversion ()
+{
+    convert_up_to (convert_frames * current_channels);
 }
 
-static void mix (float * data, float * add, int length)
+static void cancel_conversion ()
 {
-    while (length --)
-        (* data ++) += (* add ++);
+    converting = false;
+    source.clear ();
 }
 
-/* stupid simple resampling/rechanneling algorithm */
 static void reformat (int channels, int rate)
 {
+    finish_conversion ();
+
     if (channels == current_channels && rate == current_rate)
         return;
 
     int old_frames = buffer.len () / current_channels;
     int new_frames = (int64_t) old_frames * rate / current_rate;
 
-    int map[AUD_MAX_CHANNELS];
     for (int c = 0; c < channels; c ++)
-        map[c] = c * current_channels / channels;
+        source_map[c] = c * current_channels / channels;
 
-    Index<float> new_buffer;
-    new_buffer.resize (new_frames * channels);
+    if (! old_frames || ! new_frames)
+    {
+        buffer.resize (new_frames * channels);
+        buffer.erase (0, -1);
+        return;
+    }
+
+    /* deinterleave, repeating the first and last samples as padding */
+    source_channels = current_channels;
+    source_rate = current_rate;
+    source_stride = old_frames + TAPS;
+
+    source.resize (source_channels * source_stride);
 
-    for (int f = 0; f < new_frames; f ++)
+    for (int c = 0; c < source_channels; c ++)
     {
-        int f0 = (int64_t) f * current_rate / rate;
-        int s0 = f0 * current_channels;
-        int s = f * channels;
+        float * out = & source[c * source_stride];
+        const float * in = & buffer[c];
 
-        for (int c = 0; c < channels; c ++)
-            new_buffer[s + c] = buffer[s0 + map[c]];
+        for (int i = 0; i < TAPS / 2; i ++)
+            out[i] = in[0];
+
+        for (int f = 0; f < old_frames; f ++)
+            out[TAPS / 2 + f] = in[f * source_channels];
+
+        for (int i = TAPS / 2 + old_frames; i < source_stride; i ++)
+            out[i] = in[(old_frames - 1) * source_channels];
     }
 
-    buffer = std::move (new_buffer);
+    /* when downsampling, cut off below the new Nyquist frequency */
+    build_filter (0.9f * aud::min (1.0f, (float) rate / current_rate));
+
+    buffer.resize (new_frames * channels);
+
+    convert_frames = new_frames;
+    converted_frames = 0;
+    converting = true;
+    fadeout_pending = false;
 }
 
 static int buffer_needed_for_state ()
@@ -193,6 +445,8 @@ static int buffer_needed_for_state ()
 
 static void output_data_as_ready (int buffer_needed, bool exact)
 {
+    finish_conversion ();
+
     int copy = buffer.len () - buffer_needed;
 
     /* if allowed, wait until we have at least 1/2 second ready to output */
@@ -202,12 +456,24 @@ static void output_data_as_ready (int buffer_needed, bool exact)
 
 void Crossfade::start (int & channels, int & rate)
 {
+    int old_channels = current_channels, old_rate = current_rate;
+
     if (state != STATE_OFF)
         reformat (channels, rate);
 
     current_channels = channels;
     current_rate = rate;
 
+    /* a fade-in already in progress cannot be converted lazily */
+    if (state == STATE_FADEIN && (channels != old_channels || rate != old_rate))
+    {
+        int frames = (int64_t) (fadein_point / old_channels) * rate / old_rate;
+        fadein_point = aud::min (frames * channels, buffer.len ());
+        finish_conversion ();
+    }
+
+    update_curve ();
+
     if (state == STATE_OFF)
     {
         if (aud_get_bool ("crossfade", "manual"))
@@ -222,7 +488,17 @@ void Crossfade::start (int & channels, int & rate)
 
 static void run_fadeout ()
 {
-    do_ramp (buffer.begin (), buffer.len (), 1.0, 0.0);
+    update_curve ();
+
+    if (converting)
+    {
+        /* fade out the rest of the buffer as it is converted */
+        int done = converted_frames * current_channels;
+        do_ramp (buffer.begin (), done, 1.0, 1.0f - (float) converted_frames / convert_frames);
+        fadeout_pending = true;
+    }
+    else
+        do_ramp (buffer.begin (), buffer.len (), 1.0, 0.0);
 
     state = STATE_FADEIN;
     fadein_point = 0;
@@ -241,7 +517,9 @@ static void run_fadein (Index<float> & data)
         if (! aud_get_bool ("crossfade", "no_fade_in"))
             do_ramp (data.begin (), copy, a, b);
 
-        mix (& buffer[fadein_point], data.begin (), copy);
+        convert_up_to (fadein_point + copy);
+
+        dsp_mix (& buffer[fadein_point], data.begin (), copy);
         data.remove (0, copy);
 
         fadein_point += copy;
@@ -281,6 +559,8 @@ bool Crossfade::flush (bool force)
     if (! force && aud_get_bool ("crossfade", "manual"))
     {
         state = STATE_FLUSHED;
+        finish_conversion ();
+
         int buffer_needed = buffer_needed_for_state ();
         if (buffer.len () > buffer_needed)
             buffer.remove (buffer_needed, -1);
@@ -290,6 +570,7 @@ bool Crossfade::flush (bool force)
 
     state = STATE_RUNNING;
     buffer.resize (0);
+    cancel_conversion ();
 
     return true;
 }
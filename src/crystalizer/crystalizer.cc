@@ -23,6 +23,8 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/profiler.h"
+
 static const char * const cryst_defaults[] = {
  "intensity", "1",
  nullptr};
@@ -56,7 +58,7 @@ public:
     bool flush (bool force) override;
 };
 
-EXPORT Crystalizer aud_plugin_instance;
+EXPORT PROFILED (Crystalizer) aud_plugin_instance;
 
 static int cryst_channels;
 static Index<float> cryst_prev;
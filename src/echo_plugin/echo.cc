@@ -1,9 +1,18 @@
+#include <math.h>
+#include <algorithm>
+
 #include <libaudcore/i18n.h>
 #include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/dsp.h"
+#include "../effect-common/profiler.h"
+
 #define MAX_DELAY 1000
+#define MAX_OFFSET 50
+#define MAX_TAPS 4
+#define BLOCK_FRAMES 1024
 
 static const char echo_about[] =
  N_("Echo Plugin\n"
@@ -15,19 +24,56 @@ static const char * const echo_defaults[] = {
  "delay", "500",
  "feedback", "50",
  "volume", "50",
+ "pan", "0",
+ "delay2", "250",
+ "volume2", "0",
+ "pan2", "-50",
+ "delay3", "375",
+ "volume3", "0",
+ "pan3", "50",
+ "delay4", "750",
+ "volume4", "0",
+ "pan4", "0",
+ "stereo_offset", "0",
+ "damping", "FALSE",
+ "damping_cutoff", "4000",
  nullptr};
 
+/* tap 1 uses the original "delay", "volume" and "pan" settings */
+static const char * const tap_delay[MAX_TAPS] = {"delay", "delay2", "delay3", "delay4"};
+static const char * const tap_volume[MAX_TAPS] = {"volume", "volume2", "volume3", "volume4"};
+static const char * const tap_pan[MAX_TAPS] = {"pan", "pan2", "pan3", "pan4"};
+
+#define TAP_WIDGETS(label, n) \
+    WidgetLabel (label), \
+    WidgetSpin (N_("Delay:"), \
+        WidgetInt ("echo_plugin", tap_delay[n]), \
+        {0, MAX_DELAY, 10, N_("ms")}), \
+    WidgetSpin (N_("Volume:"), \
+        WidgetInt ("echo_plugin", tap_volume[n]), \
+        {0, 100, 1, "%"}), \
+    WidgetSpin (N_("Pan:"), \
+        WidgetInt ("echo_plugin", tap_pan[n]), \
+        {-100, 100, 1, "%"})
+
 static const PreferencesWidget echo_widgets[] = {
     WidgetLabel (N_("<b>Echo</b>")),
-    WidgetSpin (N_("Delay:"),
-        WidgetInt ("echo_plugin", "delay"),
-        {0, MAX_DELAY, 10, N_("ms")}),
     WidgetSpin (N_("Feedback:"),
         WidgetInt ("echo_plugin", "feedback"),
         {0, 100, 1, "%"}),
-    WidgetSpin (N_("Volume:"),
-        WidgetInt ("echo_plugin", "volume"),
-        {0, 100, 1, "%"})
+    WidgetCheck (N_("Damp feedback"),
+        WidgetBool ("echo_plugin", "damping")),
+    WidgetSpin (N_("Cutoff:"),
+        WidgetInt ("echo_plugin", "damping_cutoff"),
+        {500, 16000, 100, N_("Hz")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Right channel offset:"),
+        WidgetInt ("echo_plugin", "stereo_offset"),
+        {0, MAX_OFFSET, 1, N_("ms")}),
+    TAP_WIDGETS (N_("<b>Tap 1</b>"), 0),
+    TAP_WIDGETS (N_("<b>Tap 2</b>"), 1),
+    TAP_WIDGETS (N_("<b>Tap 3</b>"), 2),
+    TAP_WIDGETS (N_("<b>Tap 4</b>"), 3)
 };
 
 static const PluginPreferences echo_prefs = {{echo_widgets}};
@@ -51,10 +97,43 @@ public:
     Index<float> & process (Index<float> & data) override;
 };
 
-EXPORT EchoPlugin aud_plugin_instance;
+EXPORT PROFILED (EchoPlugin) aud_plugin_instance;
 
+/* The delay line is stored planar, one ring of <line_len> frames per channel,
+ * so that every tap can be read and mixed as a contiguous block. */
 static Index<float> buffer;
-static int w_ofs;
+static int line_len, w_ofs;
+
+static int echo_channels = 0;
+static int echo_rate = 0;
+
+/* where each channel sits, for the usual layouts of 1 to 8 channels; the
+ * right channel offset and the tap panning apply only to left and right
+ * speakers, and LFE is passed through without echo */
+enum Side {CENTER, LEFT, RIGHT, LFE};
+
+#define MAX_LAYOUT 8
+
+static const Side layouts[MAX_LAYOUT + 1][MAX_LAYOUT] = {
+    {},
+    {CENTER},
+    {LEFT, RIGHT},
+    {LEFT, RIGHT, CENTER},
+    {LEFT, RIGHT, LEFT, RIGHT},
+    {LEFT, RIGHT, CENTER, LEFT, RIGHT},
+    {LEFT, RIGHT, CENTER, LFE, LEFT, RIGHT},
+    {LEFT, RIGHT, CENTER, LFE, CENTER, LEFT, RIGHT},
+    {LEFT, RIGHT, CENTER, LFE, LEFT, RIGHT, LEFT, RIGHT}
+};
+
+static Side channel_side (int channels, int c)
+{
+    return (channels <= MAX_LAYOUT) ? layouts[channels][c] : CENTER;
+}
+
+/* per-channel scratch space for one block */
+static Index<float> block_in, block_out, block_fb;
+static float damping_state[AUD_MAX_CHANNELS];
 
 bool EchoPlugin::init ()
 {
@@ -65,10 +144,13 @@ bool EchoPlugin::init ()
 void EchoPlugin::cleanup ()
 {
     buffer.clear ();
-}
+    block_in.clear ();
+    block_out.clear ();
+    block_fb.clear ();
 
-static int echo_channels = 0;
-static int echo_rate = 0;
+    echo_channels = 0;
+    echo_rate = 0;
+}
 
 void EchoPlugin::start (int & channels, int & rate)
 {
@@ -77,38 +159,150 @@ void EchoPlugin::start (int & channels, int & rate)
         echo_channels = channels;
         echo_rate = rate;
 
-        buffer.resize (aud::rescale (MAX_DELAY, 1000, rate) * channels);
+        line_len = aud::rescale (MAX_DELAY + MAX_OFFSET, 1000, rate);
+
+        buffer.resize (line_len * channels);
         buffer.erase (0, -1);
 
+        block_in.resize (BLOCK_FRAMES);
+        block_out.resize (BLOCK_FRAMES);
+        block_fb.resize (BLOCK_FRAMES);
+
+        for (float & s : damping_state)
+            s = 0;
+
         w_ofs = 0;
     }
 }
 
+/* out = a + line[pos ... pos + length] * gain, wrapping around the ring */
+static void mac_from_line (float * out, const float * a, const float * line,
+ int pos, float gain, int length)
+{
+    int first = aud::min (length, line_len - pos);
+
+    dsp_mac (out, a, line + pos, gain, first);
+    dsp_mac (out + first, a + first, line, gain, length - first);
+}
+
+static void read_from_line (float * out, const float * line, int pos, int length)
+{
+    int first = aud::min (length, line_len - pos);
+
+    std::copy (line + pos, line + pos + first, out);
+    std::copy (line, line + length - first, out + first);
+}
+
+static void write_to_line (float * line, int pos, const float * data, int length)
+{
+    int first = aud::min (length, line_len - pos);
+
+    std::copy (data, data + first, line + pos);
+    std::copy (data + first, data + length, line);
+}
+
 Index<float> & EchoPlugin::process (Index<float> & data)
 {
-    int delay = aud_get_int ("echo_plugin", "delay");
+    int channels = echo_channels;
+    int frames = data.len () / channels;
+
     float feedback = aud_get_int ("echo_plugin", "feedback") / 100.0f;
-    float volume = aud_get_int ("echo_plugin", "volume") / 100.0f;
+    int offset = aud::rescale (aud_get_int ("echo_plugin", "stereo_offset"), 1000, echo_rate);
 
-    int interval = aud::rescale (delay, 1000, echo_rate) * echo_channels;
-    interval = aud::clamp (interval, 0, buffer.len ());  // sanity check
+    float damping = 0;
+    if (aud_get_bool ("echo_plugin", "damping"))
+        damping = 1.0f - expf (-2 * M_PI * aud_get_int ("echo_plugin", "damping_cutoff") / echo_rate);
 
-    int r_ofs = w_ofs - interval;
-    if (r_ofs < 0)
-        r_ofs += buffer.len ();
+    int delays[MAX_TAPS];
+    float volumes[MAX_TAPS], pans[MAX_TAPS];
+    int taps = 0;
 
-    float * end = data.end ();
+    /* the shortest delay limits the block size, since a block may not read
+     * back samples that were written earlier in the same block */
+    int min_delay = BLOCK_FRAMES;
 
-    for (float * f = data.begin (); f < end; f++)
+    for (int t = 0; t < MAX_TAPS; t ++)
     {
-        float in = * f;
-        float buf = buffer[r_ofs];
+        int delay = aud::rescale (aud_get_int ("echo_plugin", tap_delay[t]), 1000, echo_rate);
+        float volume = aud_get_int ("echo_plugin", tap_volume[t]) / 100.0f;
+
+        delay = aud::clamp (delay, 0, line_len - offset);  // sanity check
+
+        /* tap 1 drives the feedback path even if it is not heard */
+        if (t > 0 && volume == 0)
+            continue;
+
+        delays[taps] = delay;
+        volumes[taps] = volume;
+        pans[taps] = aud::clamp (aud_get_int ("echo_plugin", tap_pan[t]), -100, 100) / 100.0f;
+        taps ++;
+
+        if (delay > 0)
+            min_delay = aud::min (min_delay, delay);
+    }
+
+    for (int done = 0; done < frames; )
+    {
+        int block = aud::min (frames - done, min_delay);
+        float * frame = & data[done * channels];
+
+        for (int c = 0; c < channels; c ++)
+        {
+            Side side = channel_side (channels, c);
+            if (side == LFE)
+                continue;
+
+            float * line = & buffer[c * line_len];
+            int extra = (side == RIGHT) ? offset : 0;
+
+            for (int i = 0; i < block; i ++)
+                block_in[i] = frame[i * channels + c];
+
+            /* each tap is mixed into the output in turn */
+            const float * mix_in = block_in.begin ();
+
+            for (int t = 0; t < taps; t ++)
+            {
+                float gain = volumes[t];
+                if (side == LEFT)
+                    gain *= aud::min (1.0f, 1 - pans[t]);
+                else if (side == RIGHT)
+                    gain *= aud::min (1.0f, 1 + pans[t]);
+
+                int pos = (w_ofs - delays[t] - extra + line_len) % line_len;
+                mac_from_line (block_out.begin (), mix_in, line, pos, gain, block);
+                mix_in = block_out.begin ();
+            }
+
+            if (! taps)
+                std::copy (block_in.begin (), block_in.begin () + block, block_out.begin ());
+
+            /* feedback path: line = in + filter (line[tap 1]) * feedback */
+            int pos = (w_ofs - delays[0] - extra + line_len) % line_len;
+            read_from_line (block_fb.begin (), line, pos, block);
+
+            if (damping)
+            {
+                float state = damping_state[c];
+
+                for (int i = 0; i < block; i ++)
+                {
+                    state += (block_fb[i] - state) * damping;
+                    block_fb[i] = state;
+                }
+
+                damping_state[c] = state;
+            }
+
+            dsp_mac (block_fb.begin (), block_in.begin (), block_fb.begin (), feedback, block);
+            write_to_line (line, w_ofs, block_fb.begin (), block);
 
-        * f = in + buf * volume;
-        buffer[w_ofs] = in + buf * feedback;
+            for (int i = 0; i < block; i ++)
+                frame[i * channels + c] = block_out[i];
+        }
 
-        r_ofs = (r_ofs + 1) % buffer.len ();
-        w_ofs = (w_ofs + 1) % buffer.len ();
+        done += block;
+        w_ofs = (w_ofs + block) % line_len;
     }
 
     return data;
@@ -0,0 +1,536 @@
+/*
+ * Effect Plugin Benchmark for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+/* Runs an effect plugin outside of the player: the plugin module is loaded
+ * directly and fed synthetic or recorded audio in buffers of a fixed size.
+ * Reports the throughput, the time taken by each call, a hash of the output
+ * and optionally compares the output with a previously saved one. */
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <gmodule.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/index.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/runtime.h>
+
+enum class Signal {
+    Music,
+    Sine,
+    Sweep,
+    Noise,
+    Impulse,
+    Silence,
+    Bursts
+};
+
+static const char * const signal_names[] = {
+    "music",
+    "sine",
+    "sweep",
+    "noise",
+    "impulse",
+    "silence",
+    "bursts"
+};
+
+struct Options
+{
+    const char * plugin = nullptr;
+    const char * input = nullptr;
+    const char * save = nullptr;
+    const char * check = nullptr;
+    Signal signal = Signal::Music;
+    int channels = 2;
+    int rate = 44100;
+    int buffer = 512;  /* frames per call */
+    double seconds = 30;
+    double max_peak = 0;  /* dBFS, checked if below 0 */
+    Index<String> settings;  /* section:name=value */
+};
+
+static void usage ()
+{
+    fprintf (stderr,
+     "usage: effect-bench PLUGIN [options]\n"
+     "\n"
+     "PLUGIN is the path of an effect plugin module.\n"
+     "\n"
+     "  --channels N      channels of the input (default 2)\n"
+     "  --rate N          sample rate of the input (default 44100)\n"
+     "  --buffer N        frames passed to each call (default 512)\n"
+     "  --seconds N       length of synthetic input (default 30)\n"
+     "  --signal NAME     music, sine, sweep, noise, impulse, silence or bursts\n"
+     "  --input FILE      read interleaved 32-bit floats instead, as written\n"
+     "                    by e.g. \"sox in.flac -t f32 FILE\"\n"
+     "  --set S:NAME=VAL  change a setting of the plugin (repeatable)\n"
+     "  --save FILE       write the output as interleaved 32-bit floats\n"
+     "  --check FILE      compare the output with one saved before; the exit\n"
+     "                    status is 1 unless they are identical\n"
+     "  --max-peak DB     the exit status is 1 if any output sample is louder\n"
+     "                    than DB (dBFS, below 0)\n");
+}
+
+static bool parse_int (const char * text, int min, int & value)
+{
+    char * end;
+    long result = strtol (text, & end, 10);
+    if (end == text || * end || result < min || result > 1000000)
+        return false;
+
+    value = result;
+    return true;
+}
+
+static bool parse_options (int argc, char * * argv, Options & options)
+{
+    for (int i = 1; i < argc; i ++)
+    {
+        const char * arg = argv[i];
+
+        if (arg[0] != '-')
+        {
+            if (options.plugin)
+                return false;
+
+            options.plugin = arg;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+
+        const char * value = argv[++ i];
+
+        if (! strcmp (arg, "--channels"))
+        {
+            if (! parse_int (value, 1, options.channels))
+                return false;
+        }
+        else if (! strcmp (arg, "--rate"))
+        {
+            if (! parse_int (value, 1, options.rate))
+                return false;
+        }
+        else if (! strcmp (arg, "--buffer"))
+        {
+            if (! parse_int (value, 1, options.buffer))
+                return false;
+        }
+        else if (! strcmp (arg, "--seconds"))
+        {
+            options.seconds = str_to_double (value);
+            if (options.seconds <= 0)
+                return false;
+        }
+        else if (! strcmp (arg, "--signal"))
+        {
+            int s = 0;
+            while (s < aud::n_elems (signal_names) && strcmp (value, signal_names[s]))
+                s ++;
+
+            if (s == aud::n_elems (signal_names))
+                return false;
+
+            options.signal = (Signal) s;
+        }
+        else if (! strcmp (arg, "--input"))
+            options.input = value;
+        else if (! strcmp (arg, "--set"))
+            options.settings.append (String (value));
+        else if (! strcmp (arg, "--save"))
+            options.save = value;
+        else if (! strcmp (arg, "--check"))
+            options.check = value;
+        else if (! strcmp (arg, "--max-peak"))
+        {
+            options.max_peak = str_to_double (value);
+            if (options.max_peak >= 0)
+                return false;
+        }
+        else
+            return false;
+    }
+
+    return options.plugin != nullptr;
+}
+
+static bool apply_setting (const char * setting)
+{
+    const char * colon = strchr (setting, ':');
+    const char * equals = colon ? strchr (colon, '=') : nullptr;
+
+    if (! colon || ! equals)
+    {
+        fprintf (stderr, "Invalid setting: %s\n", setting);
+        return false;
+    }
+
+    aud_set_str (str_copy (setting, colon - setting),
+     str_copy (colon + 1, equals - (colon + 1)), equals + 1);
+
+    return true;
+}
+
+static bool read_floats (const char * filename, Index<float> & data)
+{
+    FILE * file = fopen (filename, "rb");
+    if (! file)
+    {
+        fprintf (stderr, "Cannot open %s: %s\n", filename, strerror (errno));
+        return false;
+    }
+
+    float buf[4096];
+    size_t read;
+
+    while ((read = fread (buf, sizeof (float), aud::n_elems (buf), file)) > 0)
+        data.insert (buf, -1, read);
+
+    fclose (file);
+    return true;
+}
+
+/* deterministic, so that the output can be compared between runs */
+static float noise (uint32_t & state)
+{
+    state = state * 1664525 + 1013904223;
+    return (int32_t) state * (1.0f / 2147483648.0f);
+}
+
+static void make_signal (const Options & options, Index<float> & data)
+{
+    int frames = options.seconds * options.rate;
+    data.insert (0, frames * options.channels);
+
+    uint32_t state = 1;
+    float * out = data.begin ();
+
+    for (int f = 0; f < frames; f ++)
+    {
+        double t = (double) f / options.rate;
+
+        for (int c = 0; c < options.channels; c ++)
+        {
+            float value = 0;
+
+            switch (options.signal)
+            {
+            case Signal::Music:
+                /* chords with a changing envelope and some noise, to drive
+                 * dynamics processors through their whole range */
+                value = 0.3f * sin (2 * M_PI * 220 * (c + 1) * t)
+                 + 0.2f * sin (2 * M_PI * 277.2 * t + c)
+                 + 0.1f * sin (2 * M_PI * 3520 * t);
+                value *= 0.55f + 0.45f * sin (2 * M_PI * 0.25 * t);
+                value += 0.05f * noise (state);
+                break;
+            case Signal::Sine:
+                value = 0.5f * sin (2 * M_PI * 1000 * t);
+                break;
+            case Signal::Sweep:
+                /* 20 Hz to the Nyquist frequency, exponentially */
+                value = 0.5f * sin (2 * M_PI * 20 * options.seconds /
+                 log (options.rate / 40.0) * (pow (options.rate / 40.0, t / options.seconds) - 1));
+                break;
+            case Signal::Noise:
+                value = 0.5f * noise (state);
+                break;
+            case Signal::Impulse:
+                value = (f % options.rate == 0) ? 1 : 0;
+                break;
+            case Signal::Silence:
+                break;
+            case Signal::Bursts:
+                /* a low tone starting 6 dB over full scale and decaying,
+                 * restarted every second; its level falls steadily for longer
+                 * than a limiter's lookahead on each half-wave */
+                value = 2 * sin (2 * M_PI * 30 * t + c) * exp (-fmod (t, 1.0) / 0.3);
+                break;
+            }
+
+            * out ++ = value;
+        }
+    }
+}
+
+/* compares the output with the saved one as it is produced */
+class Checker
+{
+public:
+    bool open (const char * filename)
+    {
+        m_filename = filename;
+        return read_floats (filename, m_expected);
+    }
+
+    void add (const float * data, int len)
+    {
+        for (int i = 0; i < len; i ++, m_pos ++)
+        {
+            if (m_pos >= m_expected.len ())
+                continue;
+
+            /* bitwise, so that NaN and -0 count as differences too */
+            if (! memcmp (& data[i], & m_expected[m_pos], sizeof (float)))
+                continue;
+
+            if (m_first_diff < 0)
+                m_first_diff = m_pos;
+
+            m_max_diff = aud::max (m_max_diff, fabsf (data[i] - m_expected[m_pos]));
+        }
+    }
+
+    bool report () const
+    {
+        if (m_pos != m_expected.len ())
+        {
+            printf ("check:       FAILED, %lld samples instead of %d in %s\n",
+             (long long) m_pos, m_expected.len (), m_filename);
+            return false;
+        }
+
+        if (m_first_diff >= 0)
+        {
+            printf ("check:       FAILED, first difference at sample %lld, "
+             "max difference %g\n", (long long) m_first_diff, m_max_diff);
+            return false;
+        }
+
+        printf ("check:       identical to %s\n", m_filename);
+        return true;
+    }
+
+private:
+    const char * m_filename = nullptr;
+    Index<float> m_expected;
+    int64_t m_pos = 0;
+    int64_t m_first_diff = -1;
+    float m_max_diff = 0;
+};
+
+struct Output
+{
+    FILE * save = nullptr;
+    Checker * checker = nullptr;
+    uint64_t hash = 0xcbf29ce484222325;  /* FNV-1a */
+    int64_t samples = 0;
+    float peak = 0;
+
+    void add (const Index<float> & data)
+    {
+        auto bytes = (const unsigned char *) data.begin ();
+        for (int i = 0; i < data.len () * (int) sizeof (float); i ++)
+            hash = (hash ^ bytes[i]) * 0x100000001b3;
+
+        if (save)
+            fwrite (data.begin (), sizeof (float), data.len (), save);
+        if (checker)
+            checker->add (data.begin (), data.len ());
+
+        for (float sample : data)
+            peak = aud::max (peak, fabsf (sample));
+
+        samples += data.len ();
+    }
+};
+
+static EffectPlugin * load_plugin (const char * path)
+{
+    StringBuf filename = str_has_suffix_nocase (path, G_MODULE_SUFFIX) ?
+     str_copy (path) : str_concat ({path, "." G_MODULE_SUFFIX});
+
+    GModule * module = g_module_open (filename, G_MODULE_BIND_LOCAL);
+    if (! module)
+    {
+        fprintf (stderr, "Cannot load %s: %s\n", (const char *) filename, g_module_error ());
+        return nullptr;
+    }
+
+    Plugin * header;
+    if (! g_module_symbol (module, "aud_plugin_instance", (void * *) & header) ||
+     header->magic != _AUD_PLUGIN_MAGIC)
+    {
+        fprintf (stderr, "%s is not an Audacious plugin.\n", (const char *) filename);
+        return nullptr;
+    }
+
+    if (header->version < _AUD_PLUGIN_VERSION_MIN ||
+     header->version > _AUD_PLUGIN_VERSION)
+    {
+        fprintf (stderr, "%s is not compatible with this version of Audacious.\n",
+         (const char *) filename);
+        return nullptr;
+    }
+
+    if (header->type != PluginType::Effect)
+    {
+        fprintf (stderr, "%s is not an effect plugin.\n", (const char *) filename);
+        return nullptr;
+    }
+
+    /* the module stays loaded until the program exits */
+    return (EffectPlugin *) header;
+}
+
+static double percentile (const std::vector<int64_t> & sorted, double fraction)
+{
+    if (sorted.empty ())
+        return 0;
+
+    return sorted[aud::min ((int) (fraction * sorted.size ()), (int) sorted.size () - 1)] / 1e3;
+}
+
+int main (int argc, char * * argv)
+{
+    Options options;
+
+    if (! parse_options (argc, argv, options))
+    {
+        usage ();
+        return 2;
+    }
+
+    aud_init_paths ();
+
+    EffectPlugin * plugin = load_plugin (options.plugin);
+    if (! plugin)
+        return 2;
+
+    Index<float> input;
+    if (options.input)
+    {
+        if (! read_floats (options.input, input))
+            return 2;
+
+        input.remove (input.len () - input.len () % options.channels, -1);
+    }
+    else
+        make_signal (options, input);
+
+    Checker checker;
+    Output output;
+
+    if (options.check)
+    {
+        if (! checker.open (options.check))
+            return 2;
+
+        output.checker = & checker;
+    }
+
+    if (options.save && ! (output.save = fopen (options.save, "wb")))
+    {
+        fprintf (stderr, "Cannot open %s: %s\n", options.save, strerror (errno));
+        return 2;
+    }
+
+    if (! plugin->init ())
+    {
+        fprintf (stderr, "%s failed to initialize.\n", plugin->info.name);
+        return 2;
+    }
+
+    for (const String & setting : options.settings)
+    {
+        if (! apply_setting (setting))
+            return 2;
+    }
+
+    int channels = options.channels, rate = options.rate;
+    plugin->start (channels, rate);
+
+    using Clock = std::chrono::steady_clock;
+
+    int block = options.buffer * options.channels;
+    std::vector<int64_t> times;
+    times.reserve (input.len () / block + 2);
+
+    Index<float> data;
+    data.resize (block);
+
+    for (int pos = 0; pos < input.len (); pos += block)
+    {
+        int len = aud::min (block, input.len () - pos);
+        bool last = (pos + len == input.len ());
+
+        data.resize (len);
+        memcpy (data.begin (), & input[pos], sizeof (float) * len);
+
+        auto begin = Clock::now ();
+        Index<float> & out = last ? plugin->finish (data, true) : plugin->process (data);
+        auto end = Clock::now ();
+
+        times.push_back (std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count ());
+        output.add (out);
+    }
+
+    int delay = plugin->adjust_delay (0);
+    plugin->cleanup ();
+
+    if (output.save)
+        fclose (output.save);
+
+    int64_t total_ns = 0;
+    for (int64_t ns : times)
+        total_ns += ns;
+
+    std::sort (times.begin (), times.end ());
+
+    double audio_seconds = (double) input.len () / (options.channels * options.rate);
+
+    printf ("plugin:      %s\n", plugin->info.name);
+    printf ("format:      %d ch, %d Hz -> %d ch, %d Hz\n", options.channels,
+     options.rate, channels, rate);
+    printf ("input:       %.1f s in %d calls of %d frames\n", audio_seconds,
+     (int) times.size (), options.buffer);
+    printf ("speed:       %.1f x realtime\n", total_ns ? audio_seconds * 1e9 / total_ns : 0);
+    printf ("per call:    p50 %.1f, p90 %.1f, p99 %.1f, max %.1f us\n",
+     percentile (times, 0.5), percentile (times, 0.9), percentile (times, 0.99),
+     percentile (times, 1));
+    printf ("output:      %lld samples, hash %016llx\n", (long long) output.samples,
+     (unsigned long long) output.hash);
+    printf ("delay:       %d ms reported\n", delay);
+
+    double peak_db = 20 * log10 (aud::max (output.peak, 1e-10f));
+    printf ("peak:        %.2f dBFS\n", peak_db);
+
+    bool identical = ! options.check || checker.report ();
+    bool below_peak = true;
+
+    if (options.max_peak < 0 && peak_db > options.max_peak)
+    {
+        printf ("max peak:    FAILED, above %.2f dBFS\n", options.max_peak);
+        below_peak = false;
+    }
+
+    aud_cleanup_paths ();
+    return (identical && below_peak) ? 0 : 1;
+}
@@ -0,0 +1,505 @@
+/*
+ * Dithering Requantizer for Audacious Plugins
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "dither.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <libaudcore/audio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DITHER_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DITHER_NEON
+#include <arm_neon.h>
+#endif
+
+/* The noise is generated by eight xorshift generators, one per lane of an AVX2
+ * vector; SSE2 and NEON run them as two vectors of four, the plain C version
+ * one by one.  Each lane makes two uniform numbers with 23 bits, whose
+ * difference is exact in single precision.  Since the input is scaled by a
+ * power of two, the sum with the noise is exact as well, and all versions
+ * round to nearest even, so they produce identical output. */
+
+static constexpr int LANES = 8;
+
+struct DitherKernels
+{
+    /* <length> must be a multiple of LANES */
+    void (* tpdf) (uint32_t * state, float * noise, int length);
+    /* <noise> may be null */
+    void (* quantize) (const float * in, const float * noise, int32_t * out,
+     int length, float scale, float lo, float hi);
+};
+
+static uint32_t xorshift (uint32_t & x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static float uniform (uint32_t r)
+{
+    return (r >> 9) * (1.0f / 8388608.0f);
+}
+
+static void tpdf_c (uint32_t * state, float * noise, int length)
+{
+    for (int i = 0; i < length; i += LANES)
+    {
+        for (int lane = 0; lane < LANES; lane ++)
+        {
+            float a = uniform (xorshift (state[lane]));
+            float b = uniform (xorshift (state[lane]));
+            noise[i + lane] = a - b;
+        }
+    }
+}
+
+/* written as the comparisons done by the vector min/max instructions, so that
+ * NaN is treated the same way */
+static int32_t quantize_one (float value, float lo, float hi)
+{
+    value = (value > lo) ? value : lo;
+    value = (value < hi) ? value : hi;
+    return lrintf (value);
+}
+
+static void quantize_c (const float * in, const float * noise, int32_t * out,
+ int first, int length, float scale, float lo, float hi)
+{
+    for (int i = first; i < length; i ++)
+        out[i] = quantize_one (in[i] * scale + (noise ? noise[i] : 0), lo, hi);
+}
+
+static const DitherKernels kernels_c = {
+    tpdf_c,
+    [] (const float * in, const float * noise, int32_t * out, int length,
+     float scale, float lo, float hi)
+        { quantize_c (in, noise, out, 0, length, scale, lo, hi); }
+};
+
+#ifdef DITHER_X86
+
+#define SSE2 __attribute__ ((target ("sse2")))
+#define AVX2 __attribute__ ((target ("avx2")))
+
+SSE2 static __m128i xorshift_sse2 (__m128i x)
+{
+    x = _mm_xor_si128 (x, _mm_slli_epi32 (x, 13));
+    x = _mm_xor_si128 (x, _mm_srli_epi32 (x, 17));
+    return _mm_xor_si128 (x, _mm_slli_epi32 (x, 5));
+}
+
+SSE2 static __m128 uniform_sse2 (__m128i r)
+{
+    return _mm_mul_ps (_mm_cvtepi32_ps (_mm_srli_epi32 (r, 9)),
+     _mm_set1_ps (1.0f / 8388608.0f));
+}
+
+SSE2 static void tpdf_sse2 (uint32_t * state, float * noise, int length)
+{
+    __m128i s0 = _mm_loadu_si128 ((const __m128i *) state);
+    __m128i s1 = _mm_loadu_si128 ((const __m128i *) (state + 4));
+
+    for (int i = 0; i < length; i += LANES)
+    {
+        s0 = xorshift_sse2 (s0);
+        s1 = xorshift_sse2 (s1);
+        __m128 a0 = uniform_sse2 (s0), a1 = uniform_sse2 (s1);
+
+        s0 = xorshift_sse2 (s0);
+        s1 = xorshift_sse2 (s1);
+        _mm_storeu_ps (noise + i, _mm_sub_ps (a0, uniform_sse2 (s0)));
+        _mm_storeu_ps (noise + i + 4, _mm_sub_ps (a1, uniform_sse2 (s1)));
+    }
+
+    _mm_storeu_si128 ((__m128i *) state, s0);
+    _mm_storeu_si128 ((__m128i *) (state + 4), s1);
+}
+
+SSE2 static void quantize_sse2 (const float * in, const float * noise,
+ int32_t * out, int length, float scale, float lo, float hi)
+{
+    __m128 vscale = _mm_set1_ps (scale);
+    __m128 vlo = _mm_set1_ps (lo);
+    __m128 vhi = _mm_set1_ps (hi);
+
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        __m128 v = _mm_mul_ps (_mm_loadu_ps (in + i), vscale);
+        if (noise)
+            v = _mm_add_ps (v, _mm_loadu_ps (noise + i));
+
+        v = _mm_min_ps (_mm_max_ps (v, vlo), vhi);
+        _mm_storeu_si128 ((__m128i *) (out + i), _mm_cvtps_epi32 (v));
+    }
+
+    quantize_c (in, noise, out, i, length, scale, lo, hi);
+}
+
+AVX2 static __m256i xorshift_avx2 (__m256i x)
+{
+    x = _mm256_xor_si256 (x, _mm256_slli_epi32 (x, 13));
+    x = _mm256_xor_si256 (x, _mm256_srli_epi32 (x, 17));
+    return _mm256_xor_si256 (x, _mm256_slli_epi32 (x, 5));
+}
+
+AVX2 static __m256 uniform_avx2 (__m256i r)
+{
+    return _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_srli_epi32 (r, 9)),
+     _mm256_set1_ps (1.0f / 8388608.0f));
+}
+
+AVX2 static void tpdf_avx2 (uint32_t * state, float * noise, int length)
+{
+    __m256i s = _mm256_loadu_si256 ((const __m256i *) state);
+
+    for (int i = 0; i < length; i += LANES)
+    {
+        s = xorshift_avx2 (s);
+        __m256 a = uniform_avx2 (s);
+        s = xorshift_avx2 (s);
+        _mm256_storeu_ps (noise + i, _mm256_sub_ps (a, uniform_avx2 (s)));
+    }
+
+    _mm256_storeu_si256 ((__m256i *) state, s);
+}
+
+AVX2 static void quantize_avx2 (const float * in, const float * noise,
+ int32_t * out, int length, float scale, float lo, float hi)
+{
+    __m256 vscale = _mm256_set1_ps (scale);
+    __m256 vlo = _mm256_set1_ps (lo);
+    __m256 vhi = _mm256_set1_ps (hi);
+
+    int i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        __m256 v = _mm256_mul_ps (_mm256_loadu_ps (in + i), vscale);
+        if (noise)
+            v = _mm256_add_ps (v, _mm256_loadu_ps (noise + i));
+
+        v = _mm256_min_ps (_mm256_max_ps (v, vlo), vhi);
+        _mm256_storeu_si256 ((__m256i *) (out + i), _mm256_cvtps_epi32 (v));
+    }
+
+    quantize_c (in, noise, out, i, length, scale, lo, hi);
+}
+
+static const DitherKernels kernels_sse2 = {
+    tpdf_sse2, quantize_sse2
+};
+
+static const DitherKernels kernels_avx2 = {
+    tpdf_avx2, quantize_avx2
+};
+
+#endif // DITHER_X86
+
+#ifdef DITHER_NEON
+
+static uint32x4_t xorshift_neon (uint32x4_t x)
+{
+    x = veorq_u32 (x, vshlq_n_u32 (x, 13));
+    x = veorq_u32 (x, vshrq_n_u32 (x, 17));
+    return veorq_u32 (x, vshlq_n_u32 (x, 5));
+}
+
+static float32x4_t uniform_neon (uint32x4_t r)
+{
+    return vmulq_n_f32 (vcvtq_f32_u32 (vshrq_n_u32 (r, 9)), 1.0f / 8388608.0f);
+}
+
+static void tpdf_neon (uint32_t * state, float * noise, int length)
+{
+    uint32x4_t s0 = vld1q_u32 (state);
+    uint32x4_t s1 = vld1q_u32 (state + 4);
+
+    for (int i = 0; i < length; i += LANES)
+    {
+        s0 = xorshift_neon (s0);
+        s1 = xorshift_neon (s1);
+        float32x4_t a0 = uniform_neon (s0), a1 = uniform_neon (s1);
+
+        s0 = xorshift_neon (s0);
+        s1 = xorshift_neon (s1);
+        vst1q_f32 (noise + i, vsubq_f32 (a0, uniform_neon (s0)));
+        vst1q_f32 (noise + i + 4, vsubq_f32 (a1, uniform_neon (s1)));
+    }
+
+    vst1q_u32 (state, s0);
+    vst1q_u32 (state + 4, s1);
+}
+
+static void quantize_neon (const float * in, const float * noise,
+ int32_t * out, int length, float scale, float lo, float hi)
+{
+    int i = 0;
+
+#ifdef __aarch64__
+    /* 32-bit ARM lacks a conversion rounding to nearest */
+    float32x4_t vlo = vdupq_n_f32 (lo);
+    float32x4_t vhi = vdupq_n_f32 (hi);
+
+    for (; i + 4 <= length; i += 4)
+    {
+        float32x4_t v = vmulq_n_f32 (vld1q_f32 (in + i), scale);
+        if (noise)
+            v = vaddq_f32 (v, vld1q_f32 (noise + i));
+
+        /* vmaxq/vminq would propagate NaN */
+        v = vbslq_f32 (vcgtq_f32 (v, vlo), v, vlo);
+        v = vbslq_f32 (vcltq_f32 (v, vhi), v, vhi);
+        vst1q_s32 (out + i, vcvtnq_s32_f32 (v));
+    }
+#endif
+
+    quantize_c (in, noise, out, i, length, scale, lo, hi);
+}
+
+static const DitherKernels kernels_neon = {
+    tpdf_neon, quantize_neon
+};
+
+#endif // DITHER_NEON
+
+static const DitherKernels & select_kernels ()
+{
+#ifdef DITHER_X86
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("avx2"))
+        return kernels_avx2;
+    if (__builtin_cpu_supports ("sse2"))
+        return kernels_sse2;
+#endif
+
+#ifdef DITHER_NEON
+    return kernels_neon;
+#endif
+
+    return kernels_c;
+}
+
+static const DitherKernels & kernels ()
+{
+    static const DitherKernels & selected = select_kernels ();
+    return selected;
+}
+
+/* noise shaping filters from SoX, for 44.1 kHz */
+static const float shaped_coefs[] = {1.623f, -0.982f, 0.109f};
+static const float shaped_strong_coefs[] = {2.033f, -2.165f, 1.959f, -1.590f, 0.6149f};
+
+static int format_bits (int format)
+{
+    switch (format)
+    {
+    case FMT_S16_LE:
+    case FMT_S16_BE:
+        return 16;
+    case FMT_S24_LE:
+    case FMT_S24_BE:
+    case FMT_S24_3LE:
+    case FMT_S24_3BE:
+        return 24;
+    case FMT_S32_LE:
+    case FMT_S32_BE:
+        return 32;
+    default:
+        return 0;
+    }
+}
+
+bool Requantizer::supports (int format)
+{
+    return format_bits (format) != 0;
+}
+
+void Requantizer::start (int format, int channels, int rate, int mode)
+{
+    m_format = format;
+    m_channels = aud::clamp (channels, 1, MAX_CHANNELS);
+    m_bits = format_bits (format);
+
+    /* single precision has no more than 24 bits to dither away */
+    m_mode = (m_bits < 32) ? aud::clamp (mode, 0, N_DITHER_MODES - 1) : DITHER_NONE;
+
+    if (m_mode >= DITHER_SHAPED && (rate < 44100 || rate > 48000))
+        m_mode = DITHER_TPDF;
+
+    if (m_mode == DITHER_SHAPED)
+    {
+        m_coefs = shaped_coefs;
+        m_taps = aud::n_elems (shaped_coefs);
+    }
+    else if (m_mode == DITHER_SHAPED_STRONG)
+    {
+        m_coefs = shaped_strong_coefs;
+        m_taps = aud::n_elems (shaped_strong_coefs);
+    }
+    else
+    {
+        m_coefs = nullptr;
+        m_taps = 0;
+    }
+
+    for (int lane = 0; lane < LANES; lane ++)
+        m_random[lane] = 0x9e3779b9u * (lane + 1);
+
+    m_noise.clear ();
+    m_noise_pos = 0;
+
+    flush ();
+}
+
+void Requantizer::flush ()
+{
+    m_channel = 0;
+    memset (m_error, 0, sizeof m_error);
+}
+
+const float * Requantizer::take_noise (int samples)
+{
+    int left = m_noise.len () - m_noise_pos;
+
+    if (left < samples)
+    {
+        /* keep the unused noise, then add whole groups of lanes */
+        m_noise.remove (0, m_noise_pos);
+        m_noise_pos = 0;
+
+        int add = (samples - left + LANES - 1) / LANES * LANES;
+        m_noise.insert (-1, add);
+        kernels ().tpdf (m_random, m_noise.begin () + left, add);
+    }
+
+    const float * noise = m_noise.begin () + m_noise_pos;
+    m_noise_pos += samples;
+    return noise;
+}
+
+/* the error feedback makes every sample depend on the previous one of the same
+ * channel, so this part stays scalar */
+void Requantizer::shape (const float * in, const float * noise, int32_t * out,
+ int samples)
+{
+    float scale = 1 << (m_bits - 1);
+    float lo = -scale, hi = scale - 1;
+
+    for (int i = 0; i < samples; i ++)
+    {
+        float * error = m_error[m_channel];
+
+        float feedback = 0;
+        for (int t = 0; t < m_taps; t ++)
+            feedback += m_coefs[t] * error[t];
+
+        float wanted = in[i] * scale - feedback;
+        float rounded = rintf (wanted + noise[i]);
+
+        for (int t = m_taps - 1; t > 0; t --)
+            error[t] = error[t - 1];
+
+        /* clipping is left out of the feedback, which would become unstable;
+         * the error is at most 1.5 otherwise, so this also catches NaN */
+        error[0] = rounded - wanted;
+        if (! (fabsf (error[0]) <= 2))
+            error[0] = 0;
+        out[i] = quantize_one (rounded, lo, hi);
+
+        if (++ m_channel == m_channels)
+            m_channel = 0;
+    }
+}
+
+void Requantizer::process (const float * in, void * out, int samples)
+{
+    m_temp.resize (samples);
+    int32_t * values = m_temp.begin ();
+
+    const float * noise = (m_mode == DITHER_NONE) ? nullptr : take_noise (samples);
+
+    if (m_taps)
+        shape (in, noise, values, samples);
+    else if (m_bits == 32)
+    {
+        /* the largest float below 2^31 */
+        kernels ().quantize (in, nullptr, values, samples, 2147483648.0f,
+         -2147483648.0f, 2147483520.0f);
+    }
+    else
+    {
+        float scale = 1 << (m_bits - 1);
+        kernels ().quantize (in, noise, values, samples, scale, -scale, scale - 1);
+
+        m_channel = (m_channel + samples) % m_channels;
+    }
+
+    bool swap = (m_format == FMT_S16_BE || m_format == FMT_S24_BE ||
+     m_format == FMT_S24_3BE || m_format == FMT_S32_BE);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    swap = ! swap;
+#endif
+
+    switch (m_format)
+    {
+    case FMT_S16_LE:
+    case FMT_S16_BE:
+    {
+        auto out16 = (int16_t *) out;
+        for (int i = 0; i < samples; i ++)
+            out16[i] = swap ? __builtin_bswap16 (values[i]) : values[i];
+        break;
+    }
+
+    case FMT_S24_3LE:
+    case FMT_S24_3BE:
+    {
+        auto out8 = (unsigned char *) out;
+        bool big = (m_format == FMT_S24_3BE);
+        for (int i = 0; i < samples; i ++)
+        {
+            uint32_t v = values[i];
+            out8[3 * i + (big ? 2 : 0)] = v;
+            out8[3 * i + 1] = v >> 8;
+            out8[3 * i + (big ? 0 : 2)] = v >> 16;
+        }
+        break;
+    }
+
+    default:  /* 24 or 32 bits in 32 */
+    {
+        if (swap)
+        {
+            for (int i = 0; i < samples; i ++)
+                values[i] = __builtin_bswap32 (values[i]);
+        }
+
+        memcpy (out, values, sizeof (int32_t) * samples);
+        break;
+    }
+    }
+}
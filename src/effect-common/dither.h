@@ -0,0 +1,83 @@
+/*
+ * Dithering Requantizer for Audacious Plugins
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_DITHER_H
+#define EFFECT_COMMON_DITHER_H
+
+/* Converts floating point audio to signed 16-, 24- or 32-bit integers.  Below
+ * 32 bits, TPDF dither of one LSB peak is added before rounding, optionally
+ * with noise shaping which moves the dither and rounding noise toward the
+ * upper end of the spectrum, where the ear is less sensitive.  The shaping
+ * filters are designed for 44.1 and 48 kHz; at other rates plain TPDF dither
+ * is used instead.  The noise sequence does not depend on the CPU or on how
+ * the audio is split into calls, so the output is reproducible. */
+
+#include <stdint.h>
+
+#include <libaudcore/index.h>
+
+/* stored as integers in the config files */
+enum {
+    DITHER_NONE,           /* round to nearest */
+    DITHER_TPDF,
+    DITHER_SHAPED,         /* 3-tap F-weighted (Wannamaker) */
+    DITHER_SHAPED_STRONG,  /* 5-tap E-weighted (Lipshitz) */
+    N_DITHER_MODES
+};
+
+class Requantizer
+{
+public:
+    static constexpr int MAX_CHANNELS = 32;
+    static constexpr int MAX_TAPS = 5;
+
+    /* whether <format> is one of the integer formats written by process () */
+    static bool supports (int format);
+
+    void start (int format, int channels, int rate, int mode);
+
+    /* converts <samples> interleaved samples; <out> must have room for
+     * FMT_SIZEOF (format) * samples bytes */
+    void process (const float * in, void * out, int samples);
+
+    /* forgets the noise shaping history, e.g. after seeking */
+    void flush ();
+
+private:
+    int m_format = 0;
+    int m_channels = 0;
+    int m_bits = 0;
+    int m_mode = DITHER_NONE;
+    int m_taps = 0;
+    const float * m_coefs = nullptr;
+
+    uint32_t m_random[8] {};
+    Index<float> m_noise;
+    int m_noise_pos = 0;
+
+    int m_channel = 0;  /* of the next sample */
+    float m_error[MAX_CHANNELS][MAX_TAPS] {};
+
+    Index<int32_t> m_temp;
+
+    const float * take_noise (int samples);
+    void shape (const float * in, const float * noise, int32_t * out, int samples);
+};
+
+#endif // EFFECT_COMMON_DITHER_H
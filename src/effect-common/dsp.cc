@@ -0,0 +1,549 @@
+/*
+ * Shared DSP Kernels for Audacious Effect Plugins
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "dsp.h"
+
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DSP_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DSP_NEON
+#include <arm_neon.h>
+#endif
+
+struct DSPKernels
+{
+    void (* ramp) (float * data, int length, float a, float b);
+    void (* mix) (float * data, const float * add, int length);
+    void (* mac) (float * out, const float * a, const float * b, float gain, int length);
+    float (* abs_sum) (const float * data, int length);
+    float (* peak) (const float * data, int length);
+    int (* find_first) (const float * data, int length, float threshold);
+    int (* find_last) (const float * data, int length, float threshold);
+};
+
+/* The vector versions below process as many whole vectors as possible and then
+ * hand the remainder over to these, so they must accept any <first> offset.
+ * The ramp gain is always computed from the sample index rather than by
+ * accumulating a step, so that long (multi-second) ramps do not drift. */
+
+static void ramp_c (float * data, int first, int length, float a, float step)
+{
+    for (int i = first; i < length; i ++)
+        data[i] *= a + step * i;
+}
+
+static void mix_c (float * data, const float * add, int first, int length)
+{
+    for (int i = first; i < length; i ++)
+        data[i] += add[i];
+}
+
+static void mac_c (float * out, const float * a, const float * b, float gain,
+ int first, int length)
+{
+    for (int i = first; i < length; i ++)
+        out[i] = a[i] + b[i] * gain;
+}
+
+static float abs_sum_c (const float * data, int first, int length, float sum)
+{
+    for (int i = first; i < length; i ++)
+        sum += fabsf (data[i]);
+
+    return sum;
+}
+
+static float peak_c (const float * data, int first, int length, float peak)
+{
+    for (int i = first; i < length; i ++)
+    {
+        float f = fabsf (data[i]);
+        if (f > peak)
+            peak = f;
+    }
+
+    return peak;
+}
+
+/* The search kernels compare whole vectors and only fall back to these to
+ * locate the exact sample within (or after) the first vector that matched. */
+
+static int find_first_c (const float * data, int first, int length, float threshold)
+{
+    for (int i = first; i < length; i ++)
+    {
+        if (fabsf (data[i]) > threshold)
+            return i;
+    }
+
+    return -1;
+}
+
+static int find_last_c (const float * data, int first, int last, float threshold)
+{
+    for (int i = last - 1; i >= first; i --)
+    {
+        if (fabsf (data[i]) > threshold)
+            return i;
+    }
+
+    return -1;
+}
+
+static const DSPKernels kernels_c = {
+    [] (float * data, int length, float a, float b)
+        { ramp_c (data, 0, length, a, (b - a) / length); },
+    [] (float * data, const float * add, int length)
+        { mix_c (data, add, 0, length); },
+    [] (float * out, const float * a, const float * b, float gain, int length)
+        { mac_c (out, a, b, gain, 0, length); },
+    [] (const float * data, int length)
+        { return abs_sum_c (data, 0, length, 0); },
+    [] (const float * data, int length)
+        { return peak_c (data, 0, length, 0); },
+    [] (const float * data, int length, float threshold)
+        { return find_first_c (data, 0, length, threshold); },
+    [] (const float * data, int length, float threshold)
+        { return find_last_c (data, 0, length, threshold); }
+};
+
+#ifdef DSP_X86
+
+#define SSE2 __attribute__ ((target ("sse2")))
+#define AVX2 __attribute__ ((target ("avx2")))
+
+SSE2 static float hsum_sse2 (__m128 v)
+{
+    v = _mm_add_ps (v, _mm_movehl_ps (v, v));
+    v = _mm_add_ss (v, _mm_shuffle_ps (v, v, 1));
+    return _mm_cvtss_f32 (v);
+}
+
+SSE2 static float hmax_sse2 (__m128 v)
+{
+    v = _mm_max_ps (v, _mm_movehl_ps (v, v));
+    v = _mm_max_ss (v, _mm_shuffle_ps (v, v, 1));
+    return _mm_cvtss_f32 (v);
+}
+
+SSE2 static void ramp_sse2 (float * data, int length, float a, float b)
+{
+    float step = (b - a) / length;
+    __m128 va = _mm_set1_ps (a);
+    __m128 vstep = _mm_set1_ps (step);
+    __m128 lanes = _mm_setr_ps (0, 1, 2, 3);
+
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        __m128 idx = _mm_add_ps (_mm_set1_ps ((float) i), lanes);
+        __m128 gain = _mm_add_ps (va, _mm_mul_ps (vstep, idx));
+        _mm_storeu_ps (data + i, _mm_mul_ps (_mm_loadu_ps (data + i), gain));
+    }
+
+    ramp_c (data, i, length, a, step);
+}
+
+SSE2 static void mix_sse2 (float * data, const float * add, int length)
+{
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+        _mm_storeu_ps (data + i, _mm_add_ps (_mm_loadu_ps (data + i), _mm_loadu_ps (add + i)));
+
+    mix_c (data, add, i, length);
+}
+
+SSE2 static void mac_sse2 (float * out, const float * a, const float * b,
+ float gain, int length)
+{
+    __m128 vgain = _mm_set1_ps (gain);
+
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        __m128 prod = _mm_mul_ps (_mm_loadu_ps (b + i), vgain);
+        _mm_storeu_ps (out + i, _mm_add_ps (_mm_loadu_ps (a + i), prod));
+    }
+
+    mac_c (out, a, b, gain, i, length);
+}
+
+SSE2 static float abs_sum_sse2 (const float * data, int length)
+{
+    __m128 mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+    __m128 sum = _mm_setzero_ps ();
+
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+        sum = _mm_add_ps (sum, _mm_and_ps (_mm_loadu_ps (data + i), mask));
+
+    return abs_sum_c (data, i, length, hsum_sse2 (sum));
+}
+
+SSE2 static float peak_sse2 (const float * data, int length)
+{
+    __m128 mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+    __m128 peak = _mm_setzero_ps ();
+
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+        peak = _mm_max_ps (peak, _mm_and_ps (_mm_loadu_ps (data + i), mask));
+
+    return peak_c (data, i, length, hmax_sse2 (peak));
+}
+
+SSE2 static int find_first_sse2 (const float * data, int length, float threshold)
+{
+    __m128 mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+    __m128 vthreshold = _mm_set1_ps (threshold);
+
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        __m128 above = _mm_cmpgt_ps (_mm_and_ps (_mm_loadu_ps (data + i), mask), vthreshold);
+        if (_mm_movemask_ps (above))
+            break;
+    }
+
+    return find_first_c (data, i, length, threshold);
+}
+
+SSE2 static int find_last_sse2 (const float * data, int length, float threshold)
+{
+    __m128 mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+    __m128 vthreshold = _mm_set1_ps (threshold);
+
+    int i = length;
+    for (; i >= 4; i -= 4)
+    {
+        __m128 above = _mm_cmpgt_ps (_mm_and_ps (_mm_loadu_ps (data + i - 4), mask), vthreshold);
+        if (_mm_movemask_ps (above))
+            break;
+    }
+
+    return find_last_c (data, 0, i, threshold);
+}
+
+AVX2 static float hsum_avx2 (__m256 v)
+{
+    __m128 lo = _mm256_castps256_ps128 (v);
+    __m128 hi = _mm256_extractf128_ps (v, 1);
+    lo = _mm_add_ps (lo, hi);
+    lo = _mm_add_ps (lo, _mm_movehl_ps (lo, lo));
+    lo = _mm_add_ss (lo, _mm_shuffle_ps (lo, lo, 1));
+    return _mm_cvtss_f32 (lo);
+}
+
+AVX2 static float hmax_avx2 (__m256 v)
+{
+    __m128 lo = _mm256_castps256_ps128 (v);
+    __m128 hi = _mm256_extractf128_ps (v, 1);
+    lo = _mm_max_ps (lo, hi);
+    lo = _mm_max_ps (lo, _mm_movehl_ps (lo, lo));
+    lo = _mm_max_ss (lo, _mm_shuffle_ps (lo, lo, 1));
+    return _mm_cvtss_f32 (lo);
+}
+
+AVX2 static void ramp_avx2 (float * data, int length, float a, float b)
+{
+    float step = (b - a) / length;
+    __m256 va = _mm256_set1_ps (a);
+    __m256 vstep = _mm256_set1_ps (step);
+    __m256 lanes = _mm256_setr_ps (0, 1, 2, 3, 4, 5, 6, 7);
+
+    int i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        __m256 idx = _mm256_add_ps (_mm256_set1_ps ((float) i), lanes);
+        __m256 gain = _mm256_add_ps (va, _mm256_mul_ps (vstep, idx));
+        _mm256_storeu_ps (data + i, _mm256_mul_ps (_mm256_loadu_ps (data + i), gain));
+    }
+
+    ramp_c (data, i, length, a, step);
+}
+
+AVX2 static void mix_avx2 (float * data, const float * add, int length)
+{
+    int i = 0;
+    for (; i + 8 <= length; i += 8)
+        _mm256_storeu_ps (data + i, _mm256_add_ps (_mm256_loadu_ps (data + i),
+         _mm256_loadu_ps (add + i)));
+
+    mix_c (data, add, i, length);
+}
+
+AVX2 static void mac_avx2 (float * out, const float * a, const float * b,
+ float gain, int length)
+{
+    __m256 vgain = _mm256_set1_ps (gain);
+
+    int i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        __m256 prod = _mm256_mul_ps (_mm256_loadu_ps (b + i), vgain);
+        _mm256_storeu_ps (out + i, _mm256_add_ps (_mm256_loadu_ps (a + i), prod));
+    }
+
+    mac_c (out, a, b, gain, i, length);
+}
+
+AVX2 static float abs_sum_avx2 (const float * data, int length)
+{
+    __m256 mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+    __m256 sum = _mm256_setzero_ps ();
+
+    int i = 0;
+    for (; i + 8 <= length; i += 8)
+        sum = _mm256_add_ps (sum, _mm256_and_ps (_mm256_loadu_ps (data + i), mask));
+
+    return abs_sum_c (data, i, length, hsum_avx2 (sum));
+}
+
+AVX2 static float peak_avx2 (const float * data, int length)
+{
+    __m256 mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+    __m256 peak = _mm256_setzero_ps ();
+
+    int i = 0;
+    for (; i + 8 <= length; i += 8)
+        peak = _mm256_max_ps (peak, _mm256_and_ps (_mm256_loadu_ps (data + i), mask));
+
+    return peak_c (data, i, length, hmax_avx2 (peak));
+}
+
+AVX2 static int find_first_avx2 (const float * data, int length, float threshold)
+{
+    __m256 mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+    __m256 vthreshold = _mm256_set1_ps (threshold);
+
+    int i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        __m256 abs = _mm256_and_ps (_mm256_loadu_ps (data + i), mask);
+        if (_mm256_movemask_ps (_mm256_cmp_ps (abs, vthreshold, _CMP_GT_OQ)))
+            break;
+    }
+
+    return find_first_c (data, i, length, threshold);
+}
+
+AVX2 static int find_last_avx2 (const float * data, int length, float threshold)
+{
+    __m256 mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+    __m256 vthreshold = _mm256_set1_ps (threshold);
+
+    int i = length;
+    for (; i >= 8; i -= 8)
+    {
+        __m256 abs = _mm256_and_ps (_mm256_loadu_ps (data + i - 8), mask);
+        if (_mm256_movemask_ps (_mm256_cmp_ps (abs, vthreshold, _CMP_GT_OQ)))
+            break;
+    }
+
+    return find_last_c (data, 0, i, threshold);
+}
+
+static const DSPKernels kernels_sse2 = {
+    ramp_sse2, mix_sse2, mac_sse2, abs_sum_sse2, peak_sse2,
+    find_first_sse2, find_last_sse2
+};
+
+static const DSPKernels kernels_avx2 = {
+    ramp_avx2, mix_avx2, mac_avx2, abs_sum_avx2, peak_avx2,
+    find_first_avx2, find_last_avx2
+};
+
+#endif // DSP_X86
+
+#ifdef DSP_NEON
+
+static float hsum_neon (float32x4_t v)
+{
+    float32x2_t r = vadd_f32 (vget_low_f32 (v), vget_high_f32 (v));
+    return vget_lane_f32 (vpadd_f32 (r, r), 0);
+}
+
+static float hmax_neon (float32x4_t v)
+{
+    float32x2_t r = vmax_f32 (vget_low_f32 (v), vget_high_f32 (v));
+    return vget_lane_f32 (vpmax_f32 (r, r), 0);
+}
+
+static void ramp_neon (float * data, int length, float a, float b)
+{
+    float step = (b - a) / length;
+    static const float lane_init[4] = {0, 1, 2, 3};
+    float32x4_t va = vdupq_n_f32 (a);
+    float32x4_t lanes = vld1q_f32 (lane_init);
+
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        float32x4_t idx = vaddq_f32 (vdupq_n_f32 ((float) i), lanes);
+        float32x4_t gain = vmlaq_n_f32 (va, idx, step);
+        vst1q_f32 (data + i, vmulq_f32 (vld1q_f32 (data + i), gain));
+    }
+
+    ramp_c (data, i, length, a, step);
+}
+
+static void mix_neon (float * data, const float * add, int length)
+{
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+        vst1q_f32 (data + i, vaddq_f32 (vld1q_f32 (data + i), vld1q_f32 (add + i)));
+
+    mix_c (data, add, i, length);
+}
+
+static void mac_neon (float * out, const float * a, const float * b,
+ float gain, int length)
+{
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+        vst1q_f32 (out + i, vmlaq_n_f32 (vld1q_f32 (a + i), vld1q_f32 (b + i), gain));
+
+    mac_c (out, a, b, gain, i, length);
+}
+
+static float abs_sum_neon (const float * data, int length)
+{
+    float32x4_t sum = vdupq_n_f32 (0);
+
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+        sum = vaddq_f32 (sum, vabsq_f32 (vld1q_f32 (data + i)));
+
+    return abs_sum_c (data, i, length, hsum_neon (sum));
+}
+
+static float peak_neon (const float * data, int length)
+{
+    float32x4_t peak = vdupq_n_f32 (0);
+
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+        peak = vmaxq_f32 (peak, vabsq_f32 (vld1q_f32 (data + i)));
+
+    return peak_c (data, i, length, hmax_neon (peak));
+}
+
+static bool any_neon (uint32x4_t v)
+{
+    uint32x2_t r = vorr_u32 (vget_low_u32 (v), vget_high_u32 (v));
+    return vget_lane_u64 (vreinterpret_u64_u32 (r), 0) != 0;
+}
+
+static int find_first_neon (const float * data, int length, float threshold)
+{
+    float32x4_t vthreshold = vdupq_n_f32 (threshold);
+
+    int i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        if (any_neon (vcagtq_f32 (vld1q_f32 (data + i), vthreshold)))
+            break;
+    }
+
+    return find_first_c (data, i, length, threshold);
+}
+
+static int find_last_neon (const float * data, int length, float threshold)
+{
+    float32x4_t vthreshold = vdupq_n_f32 (threshold);
+
+    int i = length;
+    for (; i >= 4; i -= 4)
+    {
+        if (any_neon (vcagtq_f32 (vld1q_f32 (data + i - 4), vthreshold)))
+            break;
+    }
+
+    return find_last_c (data, 0, i, threshold);
+}
+
+static const DSPKernels kernels_neon = {
+    ramp_neon, mix_neon, mac_neon, abs_sum_neon, peak_neon,
+    find_first_neon, find_last_neon
+};
+
+#endif // DSP_NEON
+
+static const DSPKernels & select_kernels ()
+{
+#ifdef DSP_X86
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("avx2"))
+        return kernels_avx2;
+    if (__builtin_cpu_supports ("sse2"))
+        return kernels_sse2;
+#endif
+
+#ifdef DSP_NEON
+    return kernels_neon;
+#endif
+
+    return kernels_c;
+}
+
+static const DSPKernels & kernels ()
+{
+    static const DSPKernels & selected = select_kernels ();
+    return selected;
+}
+
+void dsp_ramp (float * data, int length, float a, float b)
+{
+    if (length > 0)
+        kernels ().ramp (data, length, a, b);
+}
+
+void dsp_mix (float * data, const float * add, int length)
+{
+    kernels ().mix (data, add, length);
+}
+
+void dsp_mac (float * out, const float * a, const float * b, float gain, int length)
+{
+    kernels ().mac (out, a, b, gain, length);
+}
+
+float dsp_abs_sum (const float * data, int length)
+{
+    return kernels ().abs_sum (data, length);
+}
+
+float dsp_peak (const float * data, int length)
+{
+    return kernels ().peak (data, length);
+}
+
+int dsp_find_first_above (const float * data, int length, float threshold)
+{
+    return kernels ().find_first (data, length, threshold);
+}
+
+int dsp_find_last_above (const float * data, int length, float threshold)
+{
+    return kernels ().find_last (data, length, threshold);
+}
@@ -0,0 +1,52 @@
+/*
+ * Shared DSP Kernels for Audacious Effect Plugins
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_DSP_H
+#define EFFECT_COMMON_DSP_H
+
+/* Simple per-sample kernels used in the hot loops of several effect plugins.
+ * The best implementation for the running CPU (AVX2, SSE2, NEON, or plain C)
+ * is picked the first time any of these functions is called.  Input and output
+ * pointers may be equal (in-place), but ranges must not otherwise overlap. */
+
+/* multiplies data by a gain ramping linearly from <a> (at the first sample)
+ * toward <b> (reached one sample past the end) */
+void dsp_ramp (float * data, int length, float a, float b);
+
+/* data += add */
+void dsp_mix (float * data, const float * add, int length);
+
+/* out = a + b * gain */
+void dsp_mac (float * out, const float * a, const float * b, float gain, int length);
+
+/* sum of absolute values */
+float dsp_abs_sum (const float * data, int length);
+
+/* maximum absolute value */
+float dsp_peak (const float * data, int length);
+
+/* index of the first sample whose absolute value exceeds <threshold>, or -1;
+ * the search stops as soon as such a sample is found */
+int dsp_find_first_above (const float * data, int length, float threshold);
+
+/* index of the last sample whose absolute value exceeds <threshold>, or -1;
+ * the search starts from the end and stops as soon as one is found */
+int dsp_find_last_above (const float * data, int length, float threshold);
+
+#endif // EFFECT_COMMON_DSP_H
@@ -0,0 +1,144 @@
+/*
+ * Real FFT for Audacious Effect Plugins
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "fft.h"
+
+#include <math.h>
+#include <utility>
+
+void RealFFT::init (int size)
+{
+    if (size == m_size)
+        return;
+
+    int half = size / 2;
+
+    m_size = size;
+    m_twiddle.resize (half / 2);
+    m_post.resize (half);
+    m_work.resize (half);
+    m_bitrev.resize (half);
+
+    /* twiddle factors for the half-size complex transform */
+    for (int i = 0; i < half / 2; i ++)
+        m_twiddle[i] = std::polar (1.0f, (float) (-2 * M_PI * i / half));
+
+    /* twiddle factors for splitting the half-size transform */
+    for (int i = 0; i < half; i ++)
+        m_post[i] = std::polar (1.0f, (float) (-2 * M_PI * i / size));
+
+    int bits = 0;
+    while ((1 << bits) < half)
+        bits ++;
+
+    for (int i = 0; i < half; i ++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b ++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+
+        m_bitrev[i] = r;
+    }
+}
+
+void RealFFT::transform (Complex * data, bool inverse)
+{
+    int n = m_size / 2;
+
+    for (int i = 0; i < n; i ++)
+    {
+        int r = m_bitrev[i];
+        if (r > i)
+            std::swap (data[i], data[r]);
+    }
+
+    for (int len = 2; len <= n; len <<= 1)
+    {
+        int half = len / 2;
+        int step = n / len;
+
+        for (int start = 0; start < n; start += len)
+        {
+            Complex * a = data + start;
+            Complex * b = a + half;
+
+            for (int k = 0; k < half; k ++)
+            {
+                Complex w = m_twiddle[k * step];
+                if (inverse)
+                    w = std::conj (w);
+
+                Complex t = b[k] * w;
+                b[k] = a[k] - t;
+                a[k] += t;
+            }
+        }
+    }
+}
+
+void RealFFT::forward (const float * in, Complex * out)
+{
+    int half = m_size / 2;
+    Complex * z = m_work.begin ();
+
+    /* pack even samples as real parts and odd samples as imaginary parts */
+    for (int i = 0; i < half; i ++)
+        z[i] = Complex (in[2 * i], in[2 * i + 1]);
+
+    transform (z, false);
+
+    out[0] = Complex (z[0].real () + z[0].imag (), 0);
+    out[half] = Complex (z[0].real () - z[0].imag (), 0);
+
+    for (int k = 1; k < half; k ++)
+    {
+        Complex a = z[k];
+        Complex b = std::conj (z[half - k]);
+
+        Complex even = (a + b) * 0.5f;
+        Complex odd = (a - b) * Complex (0, -0.5f);
+
+        out[k] = even + m_post[k] * odd;
+    }
+}
+
+void RealFFT::inverse (const Complex * in, float * out)
+{
+    int half = m_size / 2;
+    Complex * z = m_work.begin ();
+
+    for (int k = 0; k < half; k ++)
+    {
+        Complex a = in[k];
+        Complex b = std::conj (in[half - k]);
+
+        Complex even = a + b;
+        Complex odd = (a - b) * std::conj (m_post[k]);
+
+        z[k] = even + Complex (0, 1) * odd;
+    }
+
+    transform (z, true);
+
+    for (int i = 0; i < half; i ++)
+    {
+        out[2 * i] = z[i].real ();
+        out[2 * i + 1] = z[i].imag ();
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * Real FFT for Audacious Effect Plugins
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_FFT_H
+#define EFFECT_COMMON_FFT_H
+
+#include <complex>
+#include <libaudcore/index.h>
+
+/* Radix-2 FFT of real data, computed as a complex FFT of half the size.  The
+ * tables are built once by init(); forward() and inverse() do not allocate.
+ * A RealFFT must not be used from two threads at the same time. */
+class RealFFT
+{
+public:
+    typedef std::complex<float> Complex;
+
+    /* <size> must be a power of two, at least 4 */
+    void init (int size);
+    int size () const { return m_size; }
+
+    /* <size> real samples -> <size> / 2 + 1 complex bins */
+    void forward (const float * in, Complex * out);
+
+    /* <size> / 2 + 1 complex bins -> <size> real samples, scaled by <size> */
+    void inverse (const Complex * in, float * out);
+
+private:
+    void transform (Complex * data, bool inverse);
+
+    int m_size = 0;
+    Index<Complex> m_twiddle, m_post, m_work;
+    Index<int> m_bitrev;
+};
+
+#endif // EFFECT_COMMON_FFT_H
@@ -0,0 +1,290 @@
+/*
+ * Effect Profiling for Audacious Effect Plugins
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_PROFILER_H
+#define EFFECT_COMMON_PROFILER_H
+
+/* Optional instrumentation, enabled with the effect-profiler build option.
+ * An effect plugin exported as PROFILED (Class) measures each of its calls on
+ * the audio thread and every few seconds of audio sends a summary as the
+ * "effect profile" event, which the Effect Profiler plugin displays and logs.
+ * Without the build option, PROFILED (Class) is just Class. */
+
+#include <stdint.h>
+
+/* summary of the calls made during one interval */
+struct EffectProfile
+{
+    char name[64];
+    int channels_in, rate_in;
+    int channels_out, rate_out;
+    int calls;
+    int64_t samples_in, samples_out;
+    double audio_ms;     /* duration of the input */
+    double cpu_ms;       /* CPU time of the audio thread inside the plugin */
+    float p50_us, p99_us, max_us;  /* wall time per call */
+    int reallocs;        /* calls that returned a moved buffer */
+    int reported_delay_ms;    /* from adjust_delay () */
+    float measured_delay_ms;  /* input minus output since start or flush */
+};
+
+#define EFFECT_PROFILE_EVENT "effect profile"
+#define EFFECT_PROFILE_INTERVAL 5000  /* milliseconds of audio */
+
+#ifdef EFFECT_PROFILING
+
+#include <string.h>
+#include <time.h>
+
+#include <libaudcore/hook.h>
+#include <libaudcore/plugin.h>
+
+class EffectProfiler
+{
+public:
+    /* call times are sorted into buckets of a quarter octave of nanoseconds */
+    static constexpr int BUCKETS = 148;
+
+    constexpr EffectProfiler () {}
+
+    void start (const char * name, int channels_in, int rate_in,
+     int channels_out, int rate_out)
+    {
+        m_name = name;
+        m_channels_in = channels_in;
+        m_rate_in = rate_in;
+        m_channels_out = channels_out;
+        m_rate_out = rate_out;
+        m_last_out = nullptr;
+        reset_delay ();
+        reset_interval ();
+    }
+
+    void reset_delay ()
+        { m_in_seconds = m_out_seconds = 0; }
+
+    /* returns false for calls made from within another measured call, for
+     * example the default finish () calling process () */
+    bool begin (int samples_in)
+    {
+        if (m_depth ++)
+            return false;
+
+        m_pending_in = samples_in;
+        clock_gettime (CLOCK_THREAD_CPUTIME_ID, & m_cpu_begin);
+        clock_gettime (CLOCK_MONOTONIC, & m_wall_begin);
+        return true;
+    }
+
+    void end (bool measured, const Index<float> & out)
+    {
+        m_depth --;
+        if (! measured)
+            return;
+
+        timespec wall_end, cpu_end;
+        clock_gettime (CLOCK_MONOTONIC, & wall_end);
+        clock_gettime (CLOCK_THREAD_CPUTIME_ID, & cpu_end);
+
+        int64_t wall_ns = elapsed_ns (m_wall_begin, wall_end);
+        m_histogram[bucket_of (wall_ns)] ++;
+        m_max_ns = aud::max (m_max_ns, wall_ns);
+        m_cpu_ns += elapsed_ns (m_cpu_begin, cpu_end);
+        m_calls ++;
+
+        if (m_last_out && out.begin () != m_last_out)
+            m_reallocs ++;
+        m_last_out = out.begin ();
+
+        m_samples_in += m_pending_in;
+        m_samples_out += out.len ();
+
+        if (m_channels_in && m_rate_in)
+            m_in_seconds += (double) m_pending_in / (m_channels_in * m_rate_in);
+        if (m_channels_out && m_rate_out)
+            m_out_seconds += (double) out.len () / (m_channels_out * m_rate_out);
+    }
+
+    /* sends the summary when the interval is complete, or right away */
+    void report (int reported_delay_ms, bool now)
+    {
+        if (! m_calls || (! now && audio_ms () < EFFECT_PROFILE_INTERVAL))
+            return;
+
+        auto profile = new EffectProfile ();
+
+        strncpy (profile->name, m_name, sizeof profile->name - 1);
+        profile->channels_in = m_channels_in;
+        profile->rate_in = m_rate_in;
+        profile->channels_out = m_channels_out;
+        profile->rate_out = m_rate_out;
+        profile->calls = m_calls;
+        profile->samples_in = m_samples_in;
+        profile->samples_out = m_samples_out;
+        profile->audio_ms = audio_ms ();
+        profile->cpu_ms = m_cpu_ns / 1e6;
+        profile->p50_us = percentile_ns (0.5) / 1e3;
+        profile->p99_us = percentile_ns (0.99) / 1e3;
+        profile->max_us = m_max_ns / 1e3;
+        profile->reallocs = m_reallocs;
+        profile->reported_delay_ms = reported_delay_ms;
+        profile->measured_delay_ms = (m_in_seconds - m_out_seconds) * 1000;
+
+        event_queue (EFFECT_PROFILE_EVENT, profile, delete_profile);
+
+        reset_interval ();
+    }
+
+private:
+    const char * m_name = nullptr;
+    int m_channels_in = 0, m_rate_in = 0;
+    int m_channels_out = 0, m_rate_out = 0;
+    int m_depth = 0;
+
+    timespec m_wall_begin {}, m_cpu_begin {};
+    int m_pending_in = 0;
+    const float * m_last_out = nullptr;
+
+    int m_calls = 0;
+    int64_t m_samples_in = 0, m_samples_out = 0;
+    int64_t m_cpu_ns = 0, m_max_ns = 0;
+    int64_t m_histogram[BUCKETS] {};
+    int m_reallocs = 0;
+
+    double m_in_seconds = 0, m_out_seconds = 0;
+
+    static void delete_profile (void * profile)
+        { delete (EffectProfile *) profile; }
+
+    static int64_t elapsed_ns (const timespec & a, const timespec & b)
+        { return (int64_t) (b.tv_sec - a.tv_sec) * 1000000000 + (b.tv_nsec - a.tv_nsec); }
+
+    static int bucket_of (int64_t ns)
+    {
+        if (ns < 4)
+            return aud::max ((int) ns, 0);
+
+        int octave = 63 - __builtin_clzll (ns);
+        int bucket = 4 * (octave - 1) + ((ns >> (octave - 2)) & 3);
+        return aud::min (bucket, BUCKETS - 1);
+    }
+
+    static int64_t bucket_start (int bucket)
+    {
+        if (bucket < 4)
+            return bucket;
+
+        int octave = bucket / 4 + 1;
+        return (int64_t) (4 + bucket % 4) << (octave - 2);
+    }
+
+    double percentile_ns (double fraction) const
+    {
+        int64_t target = (int64_t) (fraction * m_calls);
+        int64_t count = 0;
+
+        for (int b = 0; b < BUCKETS; b ++)
+        {
+            count += m_histogram[b];
+            if (count > target)
+                return 0.5 * (bucket_start (b) + bucket_start (b + 1));
+        }
+
+        return m_max_ns;
+    }
+
+    double audio_ms () const
+    {
+        if (! m_channels_in || ! m_rate_in)
+            return 0;
+
+        return m_samples_in * 1000.0 / (m_channels_in * m_rate_in);
+    }
+
+    void reset_interval ()
+    {
+        m_calls = 0;
+        m_samples_in = m_samples_out = 0;
+        m_cpu_ns = m_max_ns = 0;
+        m_reallocs = 0;
+
+        for (int64_t & count : m_histogram)
+            count = 0;
+    }
+};
+
+template<class Effect>
+class ProfiledEffect : public Effect
+{
+public:
+    using Effect::Effect;
+
+    void start (int & channels, int & rate) override
+    {
+        int channels_in = channels, rate_in = rate;
+        Effect::start (channels, rate);
+        m_profiler.start (this->info.name, channels_in, rate_in, channels, rate);
+    }
+
+    Index<float> & process (Index<float> & data) override
+    {
+        bool measured = m_profiler.begin (data.len ());
+        Index<float> & out = Effect::process (data);
+        m_profiler.end (measured, out);
+
+        if (measured)
+            m_profiler.report (Effect::adjust_delay (0), false);
+
+        return out;
+    }
+
+    bool flush (bool force) override
+    {
+        bool flushed = Effect::flush (force);
+        if (flushed)
+            m_profiler.reset_delay ();
+
+        return flushed;
+    }
+
+    Index<float> & finish (Index<float> & data, bool end_of_playlist) override
+    {
+        bool measured = m_profiler.begin (data.len ());
+        Index<float> & out = Effect::finish (data, end_of_playlist);
+        m_profiler.end (measured, out);
+
+        if (measured)
+            m_profiler.report (Effect::adjust_delay (0), true);
+
+        return out;
+    }
+
+private:
+    EffectProfiler m_profiler;
+};
+
+#define PROFILED(Effect) ProfiledEffect<Effect>
+
+#else // ! EFFECT_PROFILING
+
+#define PROFILED(Effect) Effect
+
+#endif // EFFECT_PROFILING
+
+#endif // EFFECT_COMMON_PROFILER_H
@@ -0,0 +1,299 @@
+/*
+ * Effect Profiler Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+/* Collects the summaries sent by effect plugins built with the
+ * effect-profiler option (see effect-common/profiler.h), shows the latest one
+ * of each plugin and appends all of them to a CSV file. */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <gtk/gtk.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/hook.h>
+#include <libaudcore/i18n.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/runtime.h>
+#include <libaudgui/gtk-compat.h>
+#include <libaudgui/libaudgui-gtk.h>
+#include <libaudgui/list.h>
+
+#include "../effect-common/profiler.h"
+
+class EffectProfilerPlugin : public GeneralPlugin
+{
+public:
+    static const char about[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
+
+    static constexpr PluginInfo info = {
+        N_("Effect Profiler"),
+        PACKAGE,
+        about,
+        & prefs,
+        PluginGLibOnly
+    };
+
+    constexpr EffectProfilerPlugin () : GeneralPlugin (info, false) {}
+
+    bool init () override;
+    void cleanup () override;
+};
+
+EXPORT EffectProfilerPlugin aud_plugin_instance;
+
+enum {
+    COLUMN_NAME,
+    COLUMN_FORMAT,
+    COLUMN_CALLS,
+    COLUMN_P50,
+    COLUMN_P99,
+    COLUMN_MAX,
+    COLUMN_CPU,
+    COLUMN_SAMPLES,
+    COLUMN_REALLOCS,
+    COLUMN_DELAY,
+    N_COLUMNS
+};
+
+static const char * const column_titles[N_COLUMNS] = {
+    N_("Plugin"),
+    N_("Format"),
+    N_("Calls"),
+    N_("p50 (µs)"),
+    N_("p99 (µs)"),
+    N_("Max (µs)"),
+    N_("CPU"),
+    N_("Samples in/out"),
+    N_("Reallocations"),
+    N_("Delay reported/measured")
+};
+
+static Index<EffectProfile> profiles;
+static String log_path;
+static FILE * log_file;
+static GtkWidget * profile_list;
+
+static void open_log ()
+{
+    log_path = String (filename_build ({aud_get_path (AudPath::UserDir), "effect-profile.csv"}));
+
+    log_file = fopen (log_path, "a");
+    if (! log_file)
+    {
+        AUDERR ("Cannot open %s for writing.\n", (const char *) log_path);
+        return;
+    }
+
+    if (ftell (log_file) == 0)
+        fprintf (log_file, "time,plugin,channels_in,rate_in,channels_out,rate_out,"
+         "calls,samples_in,samples_out,audio_ms,cpu_ms,p50_us,p99_us,max_us,"
+         "reallocs,reported_delay_ms,measured_delay_ms\n");
+}
+
+static void write_log (const EffectProfile & p)
+{
+    if (! log_file)
+        return;
+
+    fprintf (log_file, "%ld,\"%s\",%d,%d,%d,%d,%d,%lld,%lld,%.1f,%.3f,%.1f,%.1f,%.1f,%d,%d,%.1f\n",
+     (long) time (nullptr), p.name, p.channels_in, p.rate_in, p.channels_out,
+     p.rate_out, p.calls, (long long) p.samples_in, (long long) p.samples_out,
+     p.audio_ms, p.cpu_ms, p.p50_us, p.p99_us, p.max_us, p.reallocs,
+     p.reported_delay_ms, p.measured_delay_ms);
+
+    fflush (log_file);
+}
+
+static void profile_received (void * data, void *)
+{
+    auto & profile = * (const EffectProfile *) data;
+
+    write_log (profile);
+
+    int row = 0;
+    while (row < profiles.len () && strcmp (profiles[row].name, profile.name))
+        row ++;
+
+    if (row < profiles.len ())
+    {
+        profiles[row] = profile;
+        if (profile_list)
+            audgui_list_update_rows (profile_list, row, 1);
+    }
+    else
+    {
+        profiles.append (profile);
+        if (profile_list)
+            audgui_list_insert_rows (profile_list, row, 1);
+    }
+}
+
+static void get_value (void * user, int row, int column, GValue * value)
+{
+    g_return_if_fail (row >= 0 && row < profiles.len ());
+
+    const EffectProfile & p = profiles[row];
+    StringBuf text;
+
+    switch (column)
+    {
+    case COLUMN_NAME:
+        text = str_copy (dgettext (PACKAGE, p.name));
+        break;
+    case COLUMN_FORMAT:
+        if (p.channels_in == p.channels_out && p.rate_in == p.rate_out)
+            text = str_printf ("%d ch, %d Hz", p.channels_in, p.rate_in);
+        else
+            text = str_printf ("%d ch, %d Hz → %d ch, %d Hz", p.channels_in,
+             p.rate_in, p.channels_out, p.rate_out);
+        break;
+    case COLUMN_CALLS:
+        text = int_to_str (p.calls);
+        break;
+    case COLUMN_P50:
+        text = str_printf ("%.1f", p.p50_us);
+        break;
+    case COLUMN_P99:
+        text = str_printf ("%.1f", p.p99_us);
+        break;
+    case COLUMN_MAX:
+        text = str_printf ("%.1f", p.max_us);
+        break;
+    case COLUMN_CPU:
+        text = str_printf ("%.2f %%", p.audio_ms > 0 ? 100 * p.cpu_ms / p.audio_ms : 0.0);
+        break;
+    case COLUMN_SAMPLES:
+        text = str_printf ("%lld / %lld", (long long) p.samples_in, (long long) p.samples_out);
+        break;
+    case COLUMN_REALLOCS:
+        text = int_to_str (p.reallocs);
+        break;
+    case COLUMN_DELAY:
+        text = str_printf ("%d / %.1f ms", p.reported_delay_ms, p.measured_delay_ms);
+        break;
+    default:
+        g_return_if_reached ();
+    }
+
+    g_value_set_string (value, text);
+}
+
+static bool get_selected (void * user, int row)
+{
+    return false;
+}
+
+static void set_selected (void * user, int row, bool selected)
+{
+}
+
+static void select_all (void * user, bool selected)
+{
+}
+
+static const AudguiListCallbacks callbacks = {
+    get_value,
+    get_selected,
+    set_selected,
+    select_all
+};
+
+static void reset_profiles ()
+{
+    if (profile_list)
+        audgui_list_delete_rows (profile_list, 0, profiles.len ());
+
+    profiles.clear ();
+}
+
+static void * make_config_widget ()
+{
+    int dpi = audgui_get_dpi ();
+
+    GtkWidget * vbox = audgui_vbox_new (6);
+    gtk_widget_set_size_request (vbox, 7 * dpi, 3 * dpi);
+
+    GtkWidget * scrolled = gtk_scrolled_window_new (nullptr, nullptr);
+    gtk_scrolled_window_set_shadow_type ((GtkScrolledWindow *) scrolled, GTK_SHADOW_IN);
+    gtk_box_pack_start ((GtkBox *) vbox, scrolled, true, true, 0);
+
+    profile_list = audgui_list_new (& callbacks, nullptr, profiles.len ());
+    for (int i = 0; i < N_COLUMNS; i ++)
+        audgui_list_add_column (profile_list, _(column_titles[i]), i, G_TYPE_STRING, -1);
+
+    gtk_container_add ((GtkContainer *) scrolled, profile_list);
+
+    GtkWidget * hbox = audgui_hbox_new (6);
+    gtk_box_pack_start ((GtkBox *) vbox, hbox, false, false, 0);
+
+    GtkWidget * label = gtk_label_new (nullptr);
+    gtk_label_set_markup ((GtkLabel *) label, str_printf (_("<small>Every "
+     "summary covers about %d seconds of audio and is also written to "
+     "%s.</small>"), EFFECT_PROFILE_INTERVAL / 1000,
+     (const char *) log_path));
+    gtk_label_set_line_wrap ((GtkLabel *) label, true);
+    gtk_box_pack_start ((GtkBox *) hbox, label, true, true, 0);
+
+    GtkWidget * reset_button = gtk_button_new_with_label (_("Reset"));
+    gtk_box_pack_end ((GtkBox *) hbox, reset_button, false, false, 0);
+
+    g_signal_connect (profile_list, "destroy", (GCallback) gtk_widget_destroyed, & profile_list);
+    g_signal_connect (reset_button, "clicked", (GCallback) reset_profiles, nullptr);
+
+    return vbox;
+}
+
+bool EffectProfilerPlugin::init ()
+{
+    open_log ();
+    hook_associate (EFFECT_PROFILE_EVENT, profile_received, nullptr);
+    return true;
+}
+
+void EffectProfilerPlugin::cleanup ()
+{
+    hook_dissociate (EFFECT_PROFILE_EVENT, profile_received);
+
+    if (log_file)
+    {
+        fclose (log_file);
+        log_file = nullptr;
+    }
+
+    profiles.clear ();
+    log_path = String ();
+}
+
+const char EffectProfilerPlugin::about[] =
+ N_("Effect Profiler Plugin for Audacious\n"
+    "Copyright 2026 Audacious developers\n\n"
+    "Shows how much time each effect plugin spends processing audio and "
+    "whether the delay it reports matches its actual buffering. Only effect "
+    "plugins built with the effect-profiler option are measured.");
+
+const PreferencesWidget EffectProfilerPlugin::widgets[] = {
+    WidgetCustomGTK (make_config_widget)
+};
+
+const PluginPreferences EffectProfilerPlugin::prefs = {{widgets}};
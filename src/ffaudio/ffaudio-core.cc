@@ -33,6 +33,9 @@
 #include <libaudcore/multihash.h>
 #include <libaudcore/runtime.h>
 
+/* minimum amount of audio passed to write_audio () at once */
+#define BATCH_MS 20
+
 class FFaudio : public InputPlugin
 {
 public:
@@ -92,11 +95,7 @@ struct ScopedPacket
     ScopedPacket () { ptr = av_packet_alloc (); }
     ~ScopedPacket () { av_packet_free (& ptr); }
 
-    void clear ()
-    {
-        av_packet_free (& ptr);
-        ptr = av_packet_alloc ();
-    }
+    void clear () { av_packet_unref (ptr); }
 };
 
 struct ScopedFrame
@@ -269,7 +268,7 @@ static AVFormatContext * open_input_file (const char * name, VFSFile & file)
     }
 
     AVFormatContext * c = avformat_alloc_context ();
-    AVIOContext * io = io_context_new (file);
+    AVIOContext * io = io_context_new (name, file);
     c->pb = io;
 
     if (LOG (avformat_open_input, & c, name, f, nullptr) < 0)
@@ -440,6 +439,37 @@ static bool convert_format (int ff_fmt, int & aud_fmt, bool & planar)
     return true;
 }
 
+/* Returns the number of samples at the start of <frame> that precede <skip_to>
+ * and should be discarded; <skip_to> is reset once the target is reached.
+ * <next_ts> tracks the position for frames that come without a timestamp. */
+static int frame_skip (AVFrame * frame, AVRational tb, AVRational sample_tb,
+ int64_t & skip_to, int64_t & next_ts)
+{
+    int64_t ts = frame->best_effort_timestamp;
+    if (ts == AV_NOPTS_VALUE)
+        ts = next_ts;
+
+    if (ts != AV_NOPTS_VALUE)
+        next_ts = ts + av_rescale_q (frame->nb_samples, sample_tb, tb);
+
+    if (skip_to == AV_NOPTS_VALUE)
+        return 0;
+
+    /* position unknown, play from here */
+    if (ts == AV_NOPTS_VALUE)
+    {
+        skip_to = AV_NOPTS_VALUE;
+        return 0;
+    }
+
+    int64_t skip = av_rescale_q (skip_to - ts, tb, sample_tb);
+    if (skip >= frame->nb_samples)
+        return frame->nb_samples;
+
+    skip_to = AV_NOPTS_VALUE;
+    return aud::max (skip, (int64_t) 0);
+}
+
 bool FFaudio::play (const char * filename, VFSFile & file)
 {
     SmartPtr<AVFormatContext, close_input_file>
@@ -478,7 +508,32 @@ bool FFaudio::play (const char * filename, VFSFile & file)
     int errcount = 0;
     bool eof = false;
 
+    /* Decoded audio is collected into batches of at least BATCH_MS, since some
+     * codecs produce very small frames (a few milliseconds or less) */
+    int frame_size = FMT_SIZEOF (out_fmt) * channels;
+    int batch_size = frame_size * aud::max (context->sample_rate * BATCH_MS / 1000, 1);
+
     Index<char> buf;
+    int buffered = 0;
+    Index<const void *> planes;
+
+    /* Seeking goes to a keyframe before the target (earlier still by the
+     * codec's pre-roll, so that overlapping transforms are primed), and
+     * decoded audio is then discarded up to the exact target sample.
+     * Encoder delay and padding are trimmed by libavcodec itself, using the
+     * skip-samples side data set by the demuxer. */
+    AVStream * stream = cinfo.stream;
+    AVRational sample_tb = {1, context->sample_rate};
+    int64_t start_ts = (stream->start_time != AV_NOPTS_VALUE) ? stream->start_time : 0;
+    int preroll = stream->codecpar->seek_preroll ?
+     stream->codecpar->seek_preroll : stream->codecpar->frame_size;
+
+    int64_t skip_to = AV_NOPTS_VALUE;  /* discard audio before this timestamp */
+    int64_t next_ts = AV_NOPTS_VALUE;  /* expected timestamp of the next frame */
+
+    /* reused for each packet and frame */
+    ScopedPacket pkt;
+    ScopedFrame frame;
 
     while (! eof && ! check_stop ())
     {
@@ -486,13 +541,29 @@ bool FFaudio::play (const char * filename, VFSFile & file)
 
         if (seek_value >= 0)
         {
-            if (LOG (av_seek_frame, ic.get (), -1, (int64_t) seek_value *
-             AV_TIME_BASE / 1000, AVSEEK_FLAG_ANY) >= 0)
+            int64_t target = start_ts + av_rescale_q (seek_value, {1, 1000}, stream->time_base);
+            int64_t seek_ts = target - av_rescale_q (preroll, sample_tb, stream->time_base);
+
+            /* For formats without an index of their own (raw ADTS, DTS, etc.),
+             * libavformat keeps an index of the packets read so far for the
+             * life of the context, so seeking backward is exact and seeking
+             * forward past the indexed part reads ahead from its end. */
+            if (LOG (av_seek_frame, ic.get (), cinfo.stream_idx,
+             aud::max (seek_ts, start_ts), AVSEEK_FLAG_BACKWARD) >= 0)
+            {
+                avcodec_flush_buffers (context.ptr);
                 errcount = 0;
+                next_ts = AV_NOPTS_VALUE;
+                skip_to = target;
+            }
+            else if (next_ts != AV_NOPTS_VALUE && target > next_ts)
+                skip_to = target; /* not seekable, decode forward instead */
+
+            buffered = 0; /* drop audio from before the seek */
         }
 
         /* Read next frame (or more) of data */
-        ScopedPacket pkt;
+        pkt.clear ();
         int ret = LOG (av_read_frame, ic.get (), pkt.ptr);
 
         if (ret < 0)
@@ -523,27 +594,52 @@ bool FFaudio::play (const char * filename, VFSFile & file)
 
         while (! check_stop ())
         {
-            ScopedFrame frame;
-
             if (LOG (avcodec_receive_frame, context.ptr, frame.ptr) < 0)
                 break; /* read next packet (continue past errors) */
 
-            int size = FMT_SIZEOF (out_fmt) * channels * frame->nb_samples;
+            int skip = frame_skip (frame.ptr, stream->time_base, sample_tb, skip_to, next_ts);
+            int samples = frame->nb_samples - skip;
+
+            if (samples <= 0)
+                continue;
+
+            int size = frame_size * samples;
+
+            /* a large enough packed frame can be written as is */
+            if (! planar && ! buffered && size >= batch_size)
+            {
+                write_audio (frame->data[0] + frame_size * skip, size);
+                continue;
+            }
+
+            if (buffered + size > buf.len ())
+                buf.resize (aud::max (buffered + size, batch_size));
 
             if (planar)
             {
-                if (size > buf.len ())
-                    buf.resize (size);
+                planes.resize (channels);
+                for (int c = 0; c < channels; c ++)
+                    planes[c] = frame->extended_data[c] + FMT_SIZEOF (out_fmt) * skip;
 
-                audio_interlace ((const void * *) frame->data, out_fmt,
-                 channels, buf.begin (), frame->nb_samples);
-                write_audio (buf.begin (), size);
+                audio_interlace (planes.begin (), out_fmt, channels,
+                 buf.begin () + buffered, samples);
             }
             else
-                write_audio (frame->data[0], size);
+                memcpy (buf.begin () + buffered, frame->data[0] + frame_size * skip, size);
+
+            buffered += size;
+
+            if (buffered >= batch_size)
+            {
+                write_audio (buf.begin (), buffered);
+                buffered = 0;
+            }
         }
     }
 
+    if (buffered && ! check_stop ())
+        write_audio (buf.begin (), buffered);
+
     return true;
 }
 
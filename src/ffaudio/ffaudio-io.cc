@@ -19,31 +19,193 @@
 #define WANT_VFS_STDIO_COMPAT
 #include "ffaudio-stdinc.h"
 
+#include <libaudcore/audstrings.h>
+#include <libaudcore/runtime.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
 #define IOBUF 4096
 
-static int read_cb (void * file, unsigned char * buf, int size)
+/* Local files are read with pread () straight from the descriptor, skipping
+ * the VFS layer and its buffering.  Unlike a memory mapping, this is safe when
+ * the file is truncated while playing (as when tags are rewritten), which just
+ * ends the stream early.  A larger IO buffer keeps the number of callbacks
+ * down, and the kernel is asked to read ahead of the current position. */
+#define FD_IOBUF 65536
+#define FD_PREFETCH (1 << 20)
+
+struct IOData
+{
+    VFSFile * file;
+
+    int fd = -1;
+    int64_t pos;
+    int64_t prefetched;  /* end of the range passed to POSIX_FADV_WILLNEED */
+};
+
+static int read_cb (void * data, unsigned char * buf, int size)
 {
-    int ret = ((VFSFile *) file)->fread (buf, 1, size);
+    int ret = ((IOData *) data)->file->fread (buf, 1, size);
     return (ret > 0) ? ret : AVERROR_EOF;
 }
 
-static int64_t seek_cb (void * file, int64_t offset, int whence)
+static int64_t seek_cb (void * data, int64_t offset, int whence)
 {
+    VFSFile * file = ((IOData *) data)->file;
+
     if (whence == AVSEEK_SIZE)
-        return ((VFSFile *) file)->fsize ();
-    if (((VFSFile *) file)->fseek (offset, to_vfs_seek_type (whence & ~(int) AVSEEK_FORCE)))
+        return file->fsize ();
+    if (file->fseek (offset, to_vfs_seek_type (whence & ~(int) AVSEEK_FORCE)))
+        return -1;
+    return file->ftell ();
+}
+
+#ifndef _WIN32
+
+static int64_t fd_size (IOData * io)
+{
+    struct stat st;
+    return fstat (io->fd, & st) ? -1 : st.st_size;
+}
+
+static void fd_prefetch (IOData * io)
+{
+#ifdef POSIX_FADV_WILLNEED
+    if (io->pos < io->prefetched - FD_PREFETCH / 2)
+        return;
+
+    int64_t start = aud::max (io->pos, io->prefetched);
+    int64_t end = io->pos + FD_PREFETCH;
+
+    posix_fadvise (io->fd, start, end - start, POSIX_FADV_WILLNEED);
+    io->prefetched = end;
+#endif
+}
+
+static int fd_read_cb (void * data, unsigned char * buf, int size)
+{
+    IOData * io = (IOData *) data;
+    ssize_t ret;
+
+    while ((ret = pread (io->fd, buf, size, io->pos)) < 0 && errno == EINTR)
+        continue;
+
+    if (ret < 0)
+        return AVERROR (errno);
+    if (ret == 0)
+        return AVERROR_EOF;
+
+    io->pos += ret;
+
+    fd_prefetch (io);
+    return ret;
+}
+
+static int64_t fd_seek_cb (void * data, int64_t offset, int whence)
+{
+    IOData * io = (IOData *) data;
+
+    switch (whence & ~(int) AVSEEK_FORCE)
+    {
+    case AVSEEK_SIZE:
+        return fd_size (io);
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += io->pos;
+        break;
+    case SEEK_END:
+    {
+        int64_t size = fd_size (io);
+        if (size < 0)
+            return -1;
+
+        offset += size;
+        break;
+    }
+    default:
+        return -1;
+    }
+
+    if (offset < 0)
         return -1;
-    return ((VFSFile *) file)->ftell ();
+
+    /* a jump backward or far ahead starts a new read-ahead window */
+    if (offset < io->pos || offset >= io->prefetched)
+        io->prefetched = offset;
+
+    io->pos = offset;
+    fd_prefetch (io);
+    return offset;
+}
+
+static bool open_file (const char * name, IOData * io)
+{
+    StringBuf filename = uri_to_filename (name);
+    if (! filename)
+        return false;
+
+    int fd = open (filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat (fd, & st) || ! S_ISREG (st.st_mode))
+    {
+        close (fd);
+        return false;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    io->fd = fd;
+    io->pos = 0;
+    io->prefetched = 0;
+
+    fd_prefetch (io);
+
+    AUDDBG ("Reading %s directly.\n", (const char *) filename);
+    return true;
 }
 
-AVIOContext * io_context_new (VFSFile & file)
+#endif // _WIN32
+
+AVIOContext * io_context_new (const char * name, VFSFile & file)
 {
+    IOData * io = new IOData ();
+    io->file = & file;
+
+#ifndef _WIN32
+    if (open_file (name, io))
+    {
+        void * buf = av_malloc (FD_IOBUF);
+        return avio_alloc_context ((unsigned char *) buf, FD_IOBUF, 0, io,
+         fd_read_cb, nullptr, fd_seek_cb);
+    }
+#endif
+
     void * buf = av_malloc (IOBUF);
-    return avio_alloc_context ((unsigned char *) buf, IOBUF, 0, & file, read_cb, nullptr, seek_cb);
+    return avio_alloc_context ((unsigned char *) buf, IOBUF, 0, io, read_cb, nullptr, seek_cb);
 }
 
-void io_context_free (AVIOContext * io)
+void io_context_free (AVIOContext * context)
 {
-    av_free (io->buffer);
-    av_free (io);
+    IOData * io = (IOData *) context->opaque;
+
+#ifndef _WIN32
+    if (io->fd >= 0)
+        close (io->fd);
+#endif
+
+    delete io;
+
+    av_free (context->buffer);
+    av_free (context);
 }
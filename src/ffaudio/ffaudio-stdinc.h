@@ -32,7 +32,7 @@ extern "C" {
 #define CHECK_LIBAVFORMAT_VERSION(a, b, c) (LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT (a, b, c))
 #define CHECK_LIBAVUTIL_VERSION(a, b, c) (LIBAVUTIL_VERSION_INT >= AV_VERSION_INT (a, b, c))
 
-AVIOContext * io_context_new (VFSFile & file);
+AVIOContext * io_context_new (const char * name, VFSFile & file);
 void io_context_free (AVIOContext * context);
 
 #endif
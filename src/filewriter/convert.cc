@@ -5,16 +5,42 @@
 #include <libaudcore/audio.h>
 #include <libaudcore/index.h>
 
+#include "../effect-common/dither.h"
+
 static int in_fmt;
 static int out_fmt;
+static bool requantize;
 
 static Index<char> convert_output;
 static Index<float> convert_temp;
+static Requantizer requantizer;
+
+/* precision of a format, as far as reducing it calls for dither */
+static int format_bits (int fmt)
+{
+    switch (fmt)
+    {
+    case FMT_FLOAT:
+    case FMT_S32_LE:
+    case FMT_S32_BE:
+    case FMT_U32_LE:
+    case FMT_U32_BE:
+        return 32;
+    default:
+        return 8 * aud::min ((int) FMT_SIZEOF (fmt), 3);
+    }
+}
 
-void convert_init (int input_fmt, int output_fmt)
+void convert_init (int input_fmt, int output_fmt, int channels, int rate, int dither)
 {
     in_fmt = input_fmt;
     out_fmt = output_fmt;
+
+    requantize = (in_fmt != out_fmt && Requantizer::supports (out_fmt) &&
+     (in_fmt == FMT_FLOAT || format_bits (in_fmt) > format_bits (out_fmt)));
+
+    if (requantize)
+        requantizer.start (out_fmt, channels, rate, dither);
 }
 
 const Index<char> & convert_process (const void * ptr, int length)
@@ -25,6 +51,14 @@ const Index<char> & convert_process (const void * ptr, int length)
 
     if (in_fmt == out_fmt)
         memcpy (convert_output.begin (), ptr, FMT_SIZEOF (in_fmt) * samples);
+    else if (requantize && in_fmt == FMT_FLOAT)
+        requantizer.process ((const float *) ptr, convert_output.begin (), samples);
+    else if (requantize)
+    {
+        convert_temp.resize (samples);
+        audio_from_int (ptr, in_fmt, convert_temp.begin (), samples);
+        requantizer.process (convert_temp.begin (), convert_output.begin (), samples);
+    }
     else if (in_fmt == FMT_FLOAT)
         audio_to_int ((const float *) ptr, convert_output.begin (), out_fmt, samples);
     else if (out_fmt == FMT_FLOAT)
@@ -35,6 +35,7 @@
 
 #include "filewriter.h"
 #include "convert.h"
+#include "../effect-common/dither.h"
 
 class FileWriter : public OutputPlugin
 {
@@ -151,6 +152,8 @@ const char * const FileWriter::defaults[] = {
 #endif
  "filenamefromtags", "TRUE",
  "prependnumber", "FALSE",
+ "dither", aud::numeric_string<DITHER_TPDF>::str,
+ "wav_bits", "0",
  "save_original", "FALSE",
  "use_suffix", "FALSE",
  nullptr};
@@ -302,7 +305,7 @@ bool FileWriter::open_audio (int fmt, int rate, int nch, String & error)
     plugin = plugins[ext];
 
     int out_fmt = plugin->format_required (fmt);
-    convert_init (fmt, out_fmt);
+    convert_init (fmt, out_fmt, nch, rate, aud_get_int ("filewriter", "dither"));
 
     output_file = safe_create (filename);
     if (output_file)
@@ -380,10 +383,29 @@ static const ComboItem plugin_combo[] = {
 #endif
 };
 
+static const ComboItem wav_bits_combo[] = {
+    ComboItem (N_("As played"), 0),
+    ComboItem (N_("16 bit"), 16),
+    ComboItem (N_("24 bit"), 24)
+};
+
+static const ComboItem dither_combo[] = {
+    ComboItem (N_("None"), DITHER_NONE),
+    ComboItem (N_("Triangular (TPDF)"), DITHER_TPDF),
+    ComboItem (N_("Noise shaped"), DITHER_SHAPED),
+    ComboItem (N_("Strongly noise shaped"), DITHER_SHAPED_STRONG)
+};
+
 static const PreferencesWidget main_widgets[] = {
     WidgetCombo (N_("Output file format:"),
         WidgetInt ("filewriter", "fileext"),
         {{plugin_combo}}),
+    WidgetCombo (N_("WAV bit depth:"),
+        WidgetInt ("filewriter", "wav_bits"),
+        {{wav_bits_combo}}),
+    WidgetCombo (N_("Dithering when reducing bit depth:"),
+        WidgetInt ("filewriter", "dither"),
+        {{dither_combo}}),
     WidgetSeparator ({true}),
     WidgetRadio (N_("Save into original directory"),
         WidgetInt (save_original, save_original_cb),
@@ -130,6 +130,14 @@ static void wav_close (VFSFile & file)
 
 static int wav_format_required (int fmt)
 {
+    switch (aud_get_int ("filewriter", "wav_bits"))
+    {
+        case 16:
+            return FMT_S16_LE;
+        case 24:
+            return FMT_S24_LE;
+    }
+
     switch (fmt)
     {
         case FMT_S16_LE:
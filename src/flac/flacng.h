@@ -52,34 +52,26 @@ public:
     bool play(const char *filename, VFSFile &file) override;
 };
 
-#define BUFFER_SIZE_SAMP (FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS)
-#define BUFFER_SIZE_BYTE (BUFFER_SIZE_SAMP * (FLAC__MAX_BITS_PER_SAMPLE/8))
-
 #define SAMPLE_SIZE(a) (a == 8 ? 1 : (a == 16 ? 2 : 4))
 #define SAMPLE_FMT(a) (a == 8 ? FMT_S8 : (a == 16 ? FMT_S16_NE : (a == 24 ? FMT_S24_NE : FMT_S32_NE)))
 
+/* decoded frames are collected until at least this much audio is buffered */
+#define BATCH_MS 50
+
 struct callback_info
 {
     unsigned bits_per_sample = 0;
     unsigned sample_rate = 0;
     unsigned channels = 0;
     unsigned long total_samples = 0;
-    Index<int32_t> output_buffer;
-    int32_t *write_pointer = nullptr;
-    unsigned buffer_used = 0;
+    Index<char> output_buffer;  /* interleaved, in SAMPLE_FMT(bits_per_sample) */
+    unsigned buffer_used = 0;   /* in bytes */
     VFSFile *fd = nullptr;
     int bitrate = 0;
 
-    void alloc()
-    {
-        output_buffer.resize(BUFFER_SIZE_SAMP);
-        reset();
-    }
-
     void reset()
     {
         buffer_used = 0;
-        write_pointer = output_buffer.begin();
     }
 };
 
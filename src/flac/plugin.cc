@@ -21,68 +21,115 @@
 #include <string.h>
 
 #include <libaudcore/runtime.h>
+#include <libaudcore/threads.h>
 
 #include "flacng.h"
 
 EXPORT FLACng aud_plugin_instance;
 
 using StreamDecoderPtr = SmartPtr<FLAC__StreamDecoder, FLAC__stream_decoder_delete>;
-static StreamDecoderPtr s_decoder, s_ogg_decoder;
-static callback_info s_cinfo;
 
-bool FLACng::init()
+/* A decoder together with the callback state it was initialized with.  Each
+ * playback takes its own instance, so several files can be decoded at once. */
+struct DecoderInstance
 {
-    /* Callback structure and decoder for main decoding loop */
-    auto flac_decoder = StreamDecoderPtr(FLAC__stream_decoder_new());
-    if (!flac_decoder)
+    StreamDecoderPtr decoder;
+    callback_info cinfo;
+    bool ogg = false;
+};
+
+using DecoderInstancePtr = SmartPtr<DecoderInstance>;
+
+/* Setting up a decoder is not free, so a few idle ones are kept for reuse. */
+#define MAX_IDLE_DECODERS 4
+
+static aud::mutex s_pool_lock;
+static Index<DecoderInstancePtr> s_pool;
+
+static DecoderInstancePtr create_decoder(bool ogg)
+{
+    auto inst = SmartNew<DecoderInstance>();
+    inst->ogg = ogg;
+
+    inst->decoder.capture(FLAC__stream_decoder_new());
+    if (!inst->decoder)
     {
-        AUDERR("Could not create the main FLAC decoder instance!\n");
-        return false;
+        AUDERR("Could not create the %s FLAC decoder instance!\n", ogg ? "Ogg" : "main");
+        return DecoderInstancePtr();
     }
 
-    auto ret1 = FLAC__stream_decoder_init_stream(flac_decoder.get(),
-        read_callback, seek_callback, tell_callback, length_callback,
-        eof_callback, write_callback, metadata_callback, error_callback,
-        &s_cinfo);
+    auto ret = ogg ?
+        FLAC__stream_decoder_init_ogg_stream(inst->decoder.get(),
+            read_callback, seek_callback, tell_callback, length_callback,
+            eof_callback, write_callback, metadata_callback, error_callback,
+            &inst->cinfo) :
+        FLAC__stream_decoder_init_stream(inst->decoder.get(),
+            read_callback, seek_callback, tell_callback, length_callback,
+            eof_callback, write_callback, metadata_callback, error_callback,
+            &inst->cinfo);
 
-    if (ret1 != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+    if (ret != FLAC__STREAM_DECODER_INIT_STATUS_OK)
     {
-        AUDERR("Could not initialize the main FLAC decoder!\n");
-        return false;
+        AUDERR("Could not initialize the %s FLAC decoder!\n", ogg ? "Ogg" : "main");
+        return DecoderInstancePtr();
     }
 
-    if (FLAC_API_SUPPORTS_OGG_FLAC)
+    return inst;
+}
+
+static DecoderInstancePtr take_decoder(bool ogg)
+{
     {
-        auto ogg_flac_decoder = StreamDecoderPtr(FLAC__stream_decoder_new());
-        if (!ogg_flac_decoder)
+        auto lh = s_pool_lock.take();
+
+        for (int i = s_pool.len() - 1; i >= 0; i--)
         {
-            AUDERR("Could not create the Ogg FLAC decoder instance!\n");
-            return false;
+            if (s_pool[i]->ogg == ogg)
+            {
+                DecoderInstancePtr inst = std::move(s_pool[i]);
+                s_pool.remove(i, 1);
+                return inst;
+            }
         }
+    }
 
-        auto ret2 = FLAC__stream_decoder_init_ogg_stream(ogg_flac_decoder.get(),
-            read_callback, seek_callback, tell_callback, length_callback,
-            eof_callback, write_callback, metadata_callback, error_callback,
-            &s_cinfo);
+    return create_decoder(ogg);
+}
 
-        if (ret2 != FLAC__STREAM_DECODER_INIT_STATUS_OK)
-        {
-            AUDERR("Could not initialize the Ogg FLAC decoder!\n");
+static void return_decoder(DecoderInstancePtr inst)
+{
+    inst->cinfo = callback_info();
+
+    auto lh = s_pool_lock.take();
+    if (s_pool.len() < MAX_IDLE_DECODERS)
+        s_pool.append(std::move(inst));
+}
+
+bool FLACng::init()
+{
+    /* Check that the decoders can be set up at all */
+    auto flac_decoder = create_decoder(false);
+    if (!flac_decoder)
+        return false;
+
+    if (FLAC_API_SUPPORTS_OGG_FLAC)
+    {
+        auto ogg_flac_decoder = create_decoder(true);
+        if (!ogg_flac_decoder)
             return false;
-        }
 
-        s_ogg_decoder = std::move(ogg_flac_decoder);
+        return_decoder(std::move(ogg_flac_decoder));
     }
 
-    s_decoder = std::move(flac_decoder);
+    return_decoder(std::move(flac_decoder));
 
     return true;
 }
 
 void FLACng::cleanup()
 {
-    s_decoder.clear();
-    s_ogg_decoder.clear();
+    auto lh = s_pool_lock.take();
+    s_pool.clear();
 }
 
 bool FLACng::is_our_file(const char *filename, VFSFile &file)
@@ -96,45 +143,15 @@ bool FLACng::is_our_file(const char *filename, VFSFile &file)
     return ! strncmp (buf, "fLaC", sizeof buf);
 }
 
-static void squeeze_audio(int32_t* src, void* dst, unsigned count, unsigned res)
-{
-    int32_t* rp = src;
-    int8_t*  wp = (int8_t*) dst;
-    int16_t* wp2 = (int16_t*) dst;
-    int32_t* wp4 = (int32_t*) dst;
-
-    switch (res)
-    {
-        case 8:
-            for (unsigned i = 0; i < count; i++, wp++, rp++)
-                *wp = *rp & 0xff;
-            break;
-
-        case 16:
-            for (unsigned i = 0; i < count; i++, wp2++, rp++)
-                *wp2 = *rp & 0xffff;
-            break;
-
-        case 24:
-        case 32:
-            for (unsigned i = 0; i < count; i++, wp4++, rp++)
-                *wp4 = *rp;
-            break;
-
-        default:
-            AUDERR("Can not convert to %u bps\n", res);
-    }
-}
-
 bool FLACng::play(const char *filename, VFSFile &file)
 {
-    Index<char> play_buffer;
     bool error = false;
+    unsigned batch_size;
     bool stream = (file.fsize() < 0);
     bool _is_ogg_flac = is_ogg_flac(file);
     auto tuple = stream ? get_playback_tuple() : Tuple();
-    auto decoder = _is_ogg_flac && FLAC_API_SUPPORTS_OGG_FLAC
-                       ? s_ogg_decoder.get() : s_decoder.get();
+    DecoderInstancePtr inst;
+    FLAC__StreamDecoder *decoder;
 
     if (_is_ogg_flac && !FLAC_API_SUPPORTS_OGG_FLAC)
     {
@@ -142,22 +159,29 @@ bool FLACng::play(const char *filename, VFSFile &file)
                 "this format. Falling back to the main FLAC decoder.\n");
     }
 
-    s_cinfo.fd = &file;
+    inst = take_decoder(_is_ogg_flac && FLAC_API_SUPPORTS_OGG_FLAC);
+    if (!inst)
+        return false;
+
+    decoder = inst->decoder.get();
+    callback_info &cinfo = inst->cinfo;
+    cinfo.fd = &file;
 
-    if (read_metadata(decoder, &s_cinfo) == false)
+    if (read_metadata(decoder, &cinfo) == false)
     {
         AUDERR("Could not prepare file for playing!\n");
         error = true;
         goto ERR;
     }
 
-    play_buffer.resize(BUFFER_SIZE_BYTE);
+    batch_size = SAMPLE_SIZE(cinfo.bits_per_sample) * cinfo.channels *
+     aud::max(cinfo.sample_rate * BATCH_MS / 1000, 1u);
 
     if (stream && tuple.fetch_stream_info(file))
         set_playback_tuple(tuple.ref());
 
-    set_stream_bitrate(s_cinfo.bitrate);
-    open_audio(SAMPLE_FMT(s_cinfo.bits_per_sample), s_cinfo.sample_rate, s_cinfo.channels);
+    set_stream_bitrate(cinfo.bitrate);
+    open_audio(SAMPLE_FMT(cinfo.bits_per_sample), cinfo.sample_rate, cinfo.channels);
 
     while (FLAC__stream_decoder_get_state(decoder) != FLAC__STREAM_DECODER_END_OF_STREAM)
     {
@@ -167,11 +191,15 @@ bool FLACng::play(const char *filename, VFSFile &file)
         int seek_value = check_seek ();
         if (seek_value >= 0)
         {
-            uint64_t sample = (uint64_t) seek_value * s_cinfo.sample_rate / 1000;
+            uint64_t sample = (uint64_t) seek_value * cinfo.sample_rate / 1000;
+
+            /* drop audio from before the seek; the decoder writes the frame
+             * containing the target sample while seeking */
+            cinfo.reset();
 
             /* Avoid error when seeking to a sample >= total_samples */
-            if (s_cinfo.total_samples > 0)
-                sample = aud::min<uint64_t>(sample, s_cinfo.total_samples - 1);
+            if (cinfo.total_samples > 0)
+                sample = aud::min<uint64_t>(sample, cinfo.total_samples - 1);
 
             if (! FLAC__stream_decoder_seek_absolute(decoder, sample))
             {
@@ -192,21 +220,23 @@ bool FLACng::play(const char *filename, VFSFile &file)
         if (stream && tuple.fetch_stream_info(file))
             set_playback_tuple(tuple.ref());
 
-        squeeze_audio(s_cinfo.output_buffer.begin(), play_buffer.begin(),
-         s_cinfo.buffer_used, s_cinfo.bits_per_sample);
-        write_audio(play_buffer.begin(), s_cinfo.buffer_used *
-         SAMPLE_SIZE(s_cinfo.bits_per_sample));
-
-        s_cinfo.reset();
+        /* write several frames at once, or whatever is left at the end */
+        if (cinfo.buffer_used >= batch_size ||
+         (cinfo.buffer_used && FLAC__stream_decoder_get_state(decoder) ==
+          FLAC__STREAM_DECODER_END_OF_STREAM))
+        {
+            write_audio(cinfo.output_buffer.begin(), cinfo.buffer_used);
+            cinfo.reset();
+        }
     }
 
 ERR:
-    s_cinfo.reset();
+    cinfo.reset();
 
     if (FLAC__stream_decoder_flush(decoder) == false)
         AUDERR("Could not flush decoder state!\n");
 
-    s_cinfo = callback_info();
+    return_decoder(std::move(inst));
     return ! error;
 }
 
@@ -21,6 +21,12 @@
 #include <string.h>
 #include <FLAC/all.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <libaudcore/runtime.h>
 
 #include "flacng.h"
@@ -112,6 +118,112 @@ FLAC__StreamDecoderLengthStatus length_callback(const FLAC__StreamDecoder *decod
     return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
 }
 
+/*
+ * Interleave the decoded channels of a frame into the output buffer, keeping
+ * the low bytes of each sample (8-bit samples as S8, 16-bit as S16, others
+ * as 32-bit).  The kernels are specialised per sample size and channel count,
+ * with SIMD versions for the common stereo case.
+ */
+template<class T, unsigned C>
+static void pack_channels(const FLAC__int32 *const buffer[], T *out, unsigned frames)
+{
+    for (unsigned sample = 0; sample < frames; sample++)
+        for (unsigned channel = 0; channel < C; channel++)
+            *(out++) = (T) buffer[channel][sample];
+}
+
+template<class T>
+static void pack_stereo(const FLAC__int32 *const buffer[], T *out, unsigned frames)
+{
+    pack_channels<T, 2>(buffer, out, frames);
+}
+
+template<>
+void pack_stereo<int16_t>(const FLAC__int32 *const buffer[], int16_t *out, unsigned frames)
+{
+    const FLAC__int32 *left = buffer[0], *right = buffer[1];
+    unsigned sample = 0;
+
+#if defined(__SSE2__)
+    /* sign-extend the low 16 bits first, so that packing does not saturate */
+    auto low16 = [](const FLAC__int32 *p) {
+        __m128i a = _mm_loadu_si128((const __m128i *) p);
+        __m128i b = _mm_loadu_si128((const __m128i *) (p + 4));
+        a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        return _mm_packs_epi32(a, b);
+    };
+
+    for (; sample + 8 <= frames; sample += 8, out += 16)
+    {
+        __m128i l = low16(left + sample);
+        __m128i r = low16(right + sample);
+        _mm_storeu_si128((__m128i *) out, _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i *) (out + 8), _mm_unpackhi_epi16(l, r));
+    }
+#elif defined(__ARM_NEON)
+    for (; sample + 4 <= frames; sample += 4, out += 8)
+    {
+        int16x4x2_t lr = {{vmovn_s32(vld1q_s32(left + sample)),
+                           vmovn_s32(vld1q_s32(right + sample))}};
+        vst2_s16(out, lr);
+    }
+#endif
+
+    for (; sample < frames; sample++)
+    {
+        *(out++) = (int16_t) left[sample];
+        *(out++) = (int16_t) right[sample];
+    }
+}
+
+template<>
+void pack_stereo<int32_t>(const FLAC__int32 *const buffer[], int32_t *out, unsigned frames)
+{
+    const FLAC__int32 *left = buffer[0], *right = buffer[1];
+    unsigned sample = 0;
+
+#if defined(__SSE2__)
+    for (; sample + 4 <= frames; sample += 4, out += 8)
+    {
+        __m128i l = _mm_loadu_si128((const __m128i *) (left + sample));
+        __m128i r = _mm_loadu_si128((const __m128i *) (right + sample));
+        _mm_storeu_si128((__m128i *) out, _mm_unpacklo_epi32(l, r));
+        _mm_storeu_si128((__m128i *) (out + 4), _mm_unpackhi_epi32(l, r));
+    }
+#elif defined(__ARM_NEON)
+    for (; sample + 4 <= frames; sample += 4, out += 8)
+    {
+        int32x4x2_t lr = {{vld1q_s32(left + sample), vld1q_s32(right + sample)}};
+        vst2q_s32(out, lr);
+    }
+#endif
+
+    for (; sample < frames; sample++)
+    {
+        *(out++) = left[sample];
+        *(out++) = right[sample];
+    }
+}
+
+template<class T>
+static void pack_frame(const FLAC__int32 *const buffer[], void *out, unsigned channels, unsigned frames)
+{
+    T *wp = (T *) out;
+
+    switch (channels)
+    {
+        case 1: pack_channels<T, 1>(buffer, wp, frames); break;
+        case 2: pack_stereo<T>(buffer, wp, frames); break;
+        case 3: pack_channels<T, 3>(buffer, wp, frames); break;
+        case 4: pack_channels<T, 4>(buffer, wp, frames); break;
+        case 5: pack_channels<T, 5>(buffer, wp, frames); break;
+        case 6: pack_channels<T, 6>(buffer, wp, frames); break;
+        case 7: pack_channels<T, 7>(buffer, wp, frames); break;
+        case 8: pack_channels<T, 8>(buffer, wp, frames); break;
+    }
+}
+
 FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data)
 {
     callback_info *info = (callback_info*) client_data;
@@ -122,18 +234,24 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
         return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
     }
 
-    if (!info->output_buffer.len())
-        info->alloc();
+    unsigned sample_size = SAMPLE_SIZE(info->bits_per_sample);
+    unsigned bytes = sample_size * frame->header.channels * frame->header.blocksize;
+
+    /* room for the frames collected so far plus this one */
+    if (info->buffer_used + bytes > (unsigned) info->output_buffer.len())
+        info->output_buffer.resize(info->buffer_used + bytes);
 
-    for (unsigned sample = 0; sample < frame->header.blocksize; sample++)
+    void *out = info->output_buffer.begin() + info->buffer_used;
+
+    switch (sample_size)
     {
-        for (unsigned channel = 0; channel < frame->header.channels; channel++)
-        {
-            *(info->write_pointer++) = buffer[channel][sample];
-            info->buffer_used += 1;
-        }
+        case 1: pack_frame<int8_t>(buffer, out, frame->header.channels, frame->header.blocksize); break;
+        case 2: pack_frame<int16_t>(buffer, out, frame->header.channels, frame->header.blocksize); break;
+        case 4: pack_frame<int32_t>(buffer, out, frame->header.channels, frame->header.blocksize); break;
     }
 
+    info->buffer_used += bytes;
+
     return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
 
@@ -18,13 +18,35 @@
  */
 
 #include <assert.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "ladspa.h"
 #include "plugin.h"
 
 #include <libaudcore/runtime.h>
 
-static int ladspa_channels, ladspa_rate;
+static int ladspa_channels, ladspa_rate, ladspa_cpus;
+
+/* The audio is deinterleaved into these buffers once for the whole chain of
+ * plugins.  Plugins process it in place, unless they cannot, in which case
+ * they get a separate output buffer that is copied back. */
+static Index<Index<float>> channel_bufs;
+
+/* Channels are split into groups that no plugin instance crosses, so that
+ * each group can run through the entire chain independently, on one of
+ * these threads or on the audio thread itself. */
+#define MAX_WORKERS 7
+
+static pthread_t workers[MAX_WORKERS];
+static int n_workers;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static bool pool_quit;
+
+static int job_groups, job_group_channels, job_frames;
+static int job_next, job_done;
 
 static void start_plugin (LoadedPlugin & loaded)
 {
@@ -52,9 +74,10 @@ static void start_plugin (LoadedPlugin & loaded)
     }
 
     int instances = ladspa_channels / ports;
+    bool in_place = ! LADSPA_IS_INPLACE_BROKEN (desc.Properties);
 
-    loaded.in_bufs.insert (0, ladspa_channels);
-    loaded.out_bufs.insert (0, ladspa_channels);
+    if (! in_place)
+        loaded.out_bufs.insert (0, ladspa_channels);
 
     for (int i = 0; i < instances; i ++)
     {
@@ -68,14 +91,18 @@ static void start_plugin (LoadedPlugin & loaded)
         for (int p = 0; p < ports; p ++)
         {
             int channel = ports * i + p;
+            float * in = channel_bufs[channel].begin ();
 
-            Index<float> & in = loaded.in_bufs[channel];
-            in.insert (0, LADSPA_BUFLEN);
-            desc.connect_port (handle, plugin.in_ports[p], in.begin ());
+            desc.connect_port (handle, plugin.in_ports[p], in);
 
-            Index<float> & out = loaded.out_bufs[channel];
-            out.insert (0, LADSPA_BUFLEN);
-            desc.connect_port (handle, plugin.out_ports[p], out.begin ());
+            if (in_place)
+                desc.connect_port (handle, plugin.out_ports[p], in);
+            else
+            {
+                Index<float> & out = loaded.out_bufs[channel];
+                out.insert (0, LADSPA_BUFLEN);
+                desc.connect_port (handle, plugin.out_ports[p], out.begin ());
+            }
         }
 
         if (desc.activate)
@@ -83,54 +110,191 @@ static void start_plugin (LoadedPlugin & loaded)
     }
 }
 
-static void run_plugin (LoadedPlugin & loaded, float * data, int samples)
+/* runs every plugin in the chain on channels <first> to <first + count - 1> */
+static void run_group (int first, int count, int frames)
 {
-    if (! loaded.instances.len ())
+    for (auto & loaded : loadeds)
+    {
+        if (! loaded->instances.len ())
+            continue;
+
+        PluginData & plugin = loaded->plugin;
+        const LADSPA_Descriptor & desc = plugin.desc;
+
+        int ports = plugin.in_ports.len ();
+        assert (ports * loaded->instances.len () == ladspa_channels);
+        assert (first % ports == 0 && count % ports == 0);
+
+        for (int i = first / ports; i < (first + count) / ports; i ++)
+            desc.run (loaded->instances[i], frames);
+
+        if (loaded->out_bufs.len ())
+        {
+            for (int channel = first; channel < first + count; channel ++)
+                memcpy (channel_bufs[channel].begin (),
+                 loaded->out_bufs[channel].begin (), sizeof (float) * frames);
+        }
+    }
+}
+
+/* takes the next group of the current job, must be called with pool_mutex */
+static bool run_next_group ()
+{
+    if (job_next >= job_groups)
+        return false;
+
+    int group = job_next ++;
+    pthread_mutex_unlock (& pool_mutex);
+
+    run_group (group * job_group_channels, job_group_channels, job_frames);
+
+    pthread_mutex_lock (& pool_mutex);
+    if (++ job_done == job_groups)
+        pthread_cond_signal (& done_cond);
+
+    return true;
+}
+
+static void * worker_thread (void *)
+{
+    pthread_mutex_lock (& pool_mutex);
+
+    while (! pool_quit)
+    {
+        if (! run_next_group ())
+            pthread_cond_wait (& pool_cond, & pool_mutex);
+    }
+
+    pthread_mutex_unlock (& pool_mutex);
+    return nullptr;
+}
+
+static void start_workers (int count)
+{
+    count = aud::min (count, MAX_WORKERS);
+
+    while (n_workers < count)
+    {
+        if (pthread_create (& workers[n_workers], nullptr, worker_thread, nullptr))
+        {
+            AUDERR ("Failed to create worker thread.\n");
+            break;
+        }
+
+        n_workers ++;
+    }
+}
+
+void stop_workers ()
+{
+    pthread_mutex_lock (& pool_mutex);
+    pool_quit = true;
+    pthread_cond_broadcast (& pool_cond);
+    pthread_mutex_unlock (& pool_mutex);
+
+    for (int i = 0; i < n_workers; i ++)
+        pthread_join (workers[i], nullptr);
+
+    n_workers = 0;
+    pool_quit = false;
+}
+
+static int gcd (int a, int b)
+{
+    while (b)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/* the smallest group of channels that is not split by any plugin instance */
+static int get_group_channels ()
+{
+    int group = 1;
+
+    for (auto & loaded : loadeds)
+    {
+        if (loaded->instances.len ())
+        {
+            int ports = loaded->plugin.in_ports.len ();
+            group = group / gcd (group, ports) * ports;
+        }
+    }
+
+    return group;
+}
+
+static void run_chain (float * data, int samples)
+{
+    bool any_active = false;
+
+    for (auto & loaded : loadeds)
+    {
+        start_plugin (* loaded);
+        if (loaded->instances.len ())
+            any_active = true;
+    }
+
+    if (! any_active)
         return;
 
-    PluginData & plugin = loaded.plugin;
-    const LADSPA_Descriptor & desc = plugin.desc;
+    int group_channels = get_group_channels ();
+    int groups = ladspa_channels / group_channels;
 
-    int ports = plugin.in_ports.len ();
-    int instances = loaded.instances.len ();
-    assert (ports * instances == ladspa_channels);
+    if (groups > 1)
+        start_workers (aud::min (groups, ladspa_cpus) - 1);
 
     while (samples / ladspa_channels > 0)
     {
         int frames = aud::min (samples / ladspa_channels, LADSPA_BUFLEN);
 
-        for (int i = 0; i < instances; i ++)
+        for (int channel = 0; channel < ladspa_channels; channel ++)
         {
-            LADSPA_Handle handle = loaded.instances[i];
+            float * get = data + channel;
+            float * in = channel_bufs[channel].begin ();
+            float * in_end = in + frames;
 
-            for (int p = 0; p < ports; p ++)
+            while (in < in_end)
             {
-                int channel = ports * i + p;
-                float * get = data + channel;
-                float * in = loaded.in_bufs[channel].begin ();
-                float * in_end = in + frames;
-
-                while (in < in_end)
-                {
-                    * in ++ = * get;
-                    get += ladspa_channels;
-                }
+                * in ++ = * get;
+                get += ladspa_channels;
             }
+        }
+
+        if (groups > 1 && n_workers)
+        {
+            pthread_mutex_lock (& pool_mutex);
+
+            job_groups = groups;
+            job_group_channels = group_channels;
+            job_frames = frames;
+            job_next = job_done = 0;
+            pthread_cond_broadcast (& pool_cond);
+
+            while (run_next_group ())
+                ;
+            while (job_done < job_groups)
+                pthread_cond_wait (& done_cond, & pool_mutex);
+
+            pthread_mutex_unlock (& pool_mutex);
+        }
+        else
+            run_group (0, ladspa_channels, frames);
 
-            desc.run (handle, frames);
+        for (int channel = 0; channel < ladspa_channels; channel ++)
+        {
+            float * set = data + channel;
+            float * out = channel_bufs[channel].begin ();
+            float * out_end = out + frames;
 
-            for (int p = 0; p < ports; p ++)
+            while (out < out_end)
             {
-                int channel = ports * i + p;
-                float * set = data + channel;
-                float * out = loaded.out_bufs[channel].begin ();
-                float * out_end = out + frames;
-
-                while (out < out_end)
-                {
-                    * set = * out ++;
-                    set += ladspa_channels;
-                }
+                * set = * out ++;
+                set += ladspa_channels;
             }
         }
 
@@ -181,7 +345,6 @@ void shutdown_plugin_locked (LoadedPlugin & loaded)
     }
 
     loaded.instances.clear ();
-    loaded.in_bufs.clear ();
     loaded.out_bufs.clear ();
 }
 
@@ -194,6 +357,12 @@ void LADSPAHost::start (int & channels, int & rate)
 
     ladspa_channels = channels;
     ladspa_rate = rate;
+    ladspa_cpus = aud::max (1, (int) sysconf (_SC_NPROCESSORS_ONLN));
+
+    channel_bufs.clear ();
+    channel_bufs.insert (0, channels);
+    for (auto & buf : channel_bufs)
+        buf.insert (0, LADSPA_BUFLEN);
 
     pthread_mutex_unlock (& mutex);
 }
@@ -202,11 +371,7 @@ Index<float> & LADSPAHost::process (Index<float> & data)
 {
     pthread_mutex_lock (& mutex);
 
-    for (auto & loaded : loadeds)
-    {
-        start_plugin (* loaded);
-        run_plugin (* loaded, data.begin (), data.len ());
-    }
+    run_chain (data.begin (), data.len ());
 
     pthread_mutex_unlock (& mutex);
     return data;
@@ -227,12 +392,11 @@ Index<float> & LADSPAHost::finish (Index<float> & data, bool end_of_playlist)
 {
     pthread_mutex_lock (& mutex);
 
-    for (auto & loaded : loadeds)
-    {
-        start_plugin (* loaded);
-        run_plugin (* loaded, data.begin (), data.len ());
+    run_chain (data.begin (), data.len ());
 
-        if (end_of_playlist)
+    if (end_of_playlist)
+    {
+        for (auto & loaded : loadeds)
             shutdown_plugin_locked (* loaded);
     }
 
@@ -33,6 +33,7 @@
 #include <libaudgui/gtk-compat.h>
 #include <libaudgui/libaudgui-gtk.h>
 
+#include "../effect-common/profiler.h"
 #include "plugin.h"
 
 const char * const LADSPAHost::defaults[] = {
@@ -330,6 +331,8 @@ void LADSPAHost::cleanup ()
     module_path = String ();
 
     pthread_mutex_unlock (& mutex);
+
+    stop_workers ();
 }
 
 static void set_module_path (GtkEntry * entry)
@@ -566,4 +569,4 @@ const PreferencesWidget LADSPAHost::widgets[] = {
 
 const PluginPreferences LADSPAHost::prefs = {{widgets}};
 
-EXPORT LADSPAHost aud_plugin_instance;
+EXPORT PROFILED (LADSPAHost) aud_plugin_instance;
@@ -59,7 +59,7 @@ struct LoadedPlugin
     bool selected = false;
     bool active = false;
     Index<LADSPA_Handle> instances;
-    Index<Index<float>> in_bufs, out_bufs;
+    Index<Index<float>> out_bufs;  /* only if in-place processing is broken */
     GtkWidget * settings_win = nullptr;
 
     LoadedPlugin (PluginData & plugin) :
@@ -113,6 +113,7 @@ void disable_plugin_locked (LoadedPlugin & loaded);
 /* effect.c */
 
 void shutdown_plugin_locked (LoadedPlugin & loaded);
+void stop_workers ();
 
 /* plugin-list.c */
 
@@ -0,0 +1,490 @@
+/*
+ * LV2 Host for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Based on the LADSPA Host:
+ * Copyright 2011 John Lindgren
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+
+#include <string.h>
+
+#include <lv2/atom/atom.h>
+#include <lv2/buf-size/buf-size.h>
+#include <lv2/parameters/parameters.h>
+
+#include <libaudcore/ringbuf.h>
+#include <libaudcore/runtime.h>
+
+#include "plugin.h"
+
+static int lv2_channels, lv2_rate;
+static LV2_URID atom_chunk, atom_sequence;
+
+/* The audio is deinterleaved into these buffers once for the whole chain of
+ * plugins.  Plugins process it in place, unless they cannot, in which case
+ * they get a separate output buffer that is copied back. */
+static Index<Index<float>> channel_bufs;
+
+/* Plugins that need a fixed (or power of two) block length always get blocks
+ * of exactly LV2_BUFLEN frames.  When one of them is active, the whole chain
+ * runs on such blocks, collected in these FIFOs, which delays the audio by one
+ * block. */
+static bool fixed_mode;
+static RingBuf<float> fifo_in, fifo_out;
+static Index<float> block;
+
+static LV2_Feature map_feature = {LV2_URID__map, & urid_map};
+static LV2_Feature unmap_feature = {LV2_URID__unmap, & urid_unmap};
+static LV2_Feature bounded_feature = {LV2_BUF_SIZE__boundedBlockLength, nullptr};
+static LV2_Feature fixed_feature = {LV2_BUF_SIZE__fixedBlockLength, nullptr};
+static LV2_Feature pow2_feature = {LV2_BUF_SIZE__powerOf2BlockLength, nullptr};
+
+static void setup_features (PluginData & plugin, InstanceData & inst)
+{
+    LV2_URID atom_int = map_uri (LV2_ATOM__Int);
+
+    inst.block_lengths[0] = plugin.fixed_block ? LV2_BUFLEN : 1;
+    inst.block_lengths[1] = LV2_BUFLEN;
+    inst.block_lengths[2] = LV2_BUFLEN;
+    inst.sample_rate = lv2_rate;
+
+    const char * const keys[] = {
+        LV2_BUF_SIZE__minBlockLength,
+        LV2_BUF_SIZE__maxBlockLength,
+        LV2_BUF_SIZE__nominalBlockLength
+    };
+
+    for (int i = 0; i < 3; i ++)
+        inst.options[i] = {LV2_OPTIONS_INSTANCE, 0, map_uri (keys[i]),
+         sizeof (int32_t), atom_int, & inst.block_lengths[i]};
+
+    inst.options[3] = {LV2_OPTIONS_INSTANCE, 0, map_uri (LV2_PARAMETERS__sampleRate),
+     sizeof (float), map_uri (LV2_ATOM__Float), & inst.sample_rate};
+    inst.options[4] = {LV2_OPTIONS_INSTANCE, 0, 0, 0, 0, nullptr};
+
+    inst.options_feature = {LV2_OPTIONS__options, inst.options};
+
+    inst.features.append (& map_feature);
+    inst.features.append (& unmap_feature);
+    inst.features.append (& inst.options_feature);
+    inst.features.append (& bounded_feature);
+
+    if (plugin.fixed_block)
+    {
+        inst.features.append (& fixed_feature);
+        inst.features.append (& pow2_feature);
+    }
+
+    if (plugin.has_worker)
+    {
+        prepare_worker (inst);
+        inst.schedule = {& inst, schedule_work};
+        inst.schedule_feature = {LV2_WORKER__schedule, & inst.schedule};
+        inst.features.append (& inst.schedule_feature);
+    }
+
+    inst.features.append (nullptr);
+}
+
+static void free_instance (InstanceData & inst)
+{
+    if (! inst.instance)
+        return;
+
+    forget_instance (inst);
+
+    lilv_instance_deactivate (inst.instance);
+    lilv_instance_free (inst.instance);
+    inst.instance = nullptr;
+}
+
+static void free_instances (LoadedPlugin & loaded)
+{
+    for (auto & inst : loaded.instances)
+        free_instance (* inst);
+
+    loaded.instances.clear ();
+    loaded.out_bufs.clear ();
+}
+
+static void start_plugin (LoadedPlugin & loaded)
+{
+    if (loaded.active)
+        return;
+
+    loaded.active = 1;
+
+    PluginData & plugin = loaded.plugin;
+
+    int ports = plugin.in_ports.len ();
+
+    if (ports == 0 || ports != plugin.out_ports.len ())
+    {
+        AUDERR ("Plugin has unusable port configuration: %s\n", (const char *) plugin.name);
+        return;
+    }
+
+    if (lv2_channels % ports != 0)
+    {
+        AUDERR ("Plugin cannot be used with %d channels: %s\n",
+         lv2_channels, (const char *) plugin.name);
+        return;
+    }
+
+    int instances = lv2_channels / ports;
+
+    if (plugin.in_place_broken)
+        loaded.out_bufs.insert (0, lv2_channels);
+
+    for (int i = 0; i < instances; i ++)
+    {
+        InstanceData & inst = * loaded.instances.append (new InstanceData);
+
+        setup_features (plugin, inst);
+
+        inst.instance = lilv_plugin_instantiate (plugin.lilv, lv2_rate, inst.features.begin ());
+
+        if (! inst.instance)
+        {
+            AUDERR ("Failed to instantiate plugin: %s\n", (const char *) plugin.name);
+            free_instances (loaded);
+            return;
+        }
+
+        if (plugin.has_worker)
+            inst.worker = (const LV2_Worker_Interface *)
+             lilv_instance_get_extension_data (inst.instance, LV2_WORKER__interface);
+
+        int controls = plugin.controls.len ();
+        for (int c = 0; c < controls; c ++)
+            lilv_instance_connect_port (inst.instance, plugin.controls[c].port, & loaded.values[c]);
+
+        for (int p = 0; p < ports; p ++)
+        {
+            int channel = ports * i + p;
+            float * in = channel_bufs[channel].begin ();
+
+            lilv_instance_connect_port (inst.instance, plugin.in_ports[p], in);
+
+            if (! plugin.in_place_broken)
+                lilv_instance_connect_port (inst.instance, plugin.out_ports[p], in);
+            else
+            {
+                Index<float> & out = loaded.out_bufs[channel];
+                out.insert (0, LV2_BUFLEN);
+                lilv_instance_connect_port (inst.instance, plugin.out_ports[p], out.begin ());
+            }
+        }
+
+        int scratch = plugin.scratch_ports.len ();
+        inst.scratch.insert (0, LV2_BUFLEN * scratch);
+
+        for (int s = 0; s < scratch; s ++)
+            lilv_instance_connect_port (inst.instance, plugin.scratch_ports[s],
+             & inst.scratch[LV2_BUFLEN * s]);
+
+        int atom_ins = plugin.atom_in_ports.len ();
+        int atom_outs = plugin.atom_out_ports.len ();
+        inst.atom_bufs.insert (0, atom_ins + atom_outs);
+
+        for (int a = 0; a < atom_ins + atom_outs; a ++)
+        {
+            int port = (a < atom_ins) ? plugin.atom_in_ports[a] : plugin.atom_out_ports[a - atom_ins];
+
+            inst.atom_bufs[a].insert (0, LV2_ATOM_BUFLEN);
+            lilv_instance_connect_port (inst.instance, port, inst.atom_bufs[a].begin ());
+        }
+
+        lilv_instance_activate (inst.instance);
+    }
+}
+
+/* input sequences are empty; outputs announce the space that is available */
+static void reset_atom_bufs (PluginData & plugin, InstanceData & inst)
+{
+    int atom_ins = plugin.atom_in_ports.len ();
+
+    for (int a = 0; a < inst.atom_bufs.len (); a ++)
+    {
+        auto seq = (LV2_Atom_Sequence *) inst.atom_bufs[a].begin ();
+
+        if (a < atom_ins)
+        {
+            seq->atom.size = sizeof (LV2_Atom_Sequence_Body);
+            seq->atom.type = atom_sequence;
+        }
+        else
+        {
+            seq->atom.size = LV2_ATOM_BUFLEN - sizeof (LV2_Atom);
+            seq->atom.type = atom_chunk;
+        }
+
+        seq->body.unit = 0;
+        seq->body.pad = 0;
+    }
+}
+
+static void run_block (int frames)
+{
+    for (auto & loaded : loadeds)
+    {
+        if (! loaded->instances.len ())
+            continue;
+
+        PluginData & plugin = loaded->plugin;
+
+        for (auto & inst : loaded->instances)
+        {
+            reset_atom_bufs (plugin, * inst);
+            lilv_instance_run (inst->instance, frames);
+            deliver_responses (* inst);
+        }
+
+        if (loaded->out_bufs.len ())
+        {
+            for (int channel = 0; channel < lv2_channels; channel ++)
+                memcpy (channel_bufs[channel].begin (),
+                 loaded->out_bufs[channel].begin (), sizeof (float) * frames);
+        }
+    }
+}
+
+/* runs the chain on up to LV2_BUFLEN frames of interleaved audio */
+static void run_frames (float * data, int frames)
+{
+    for (int channel = 0; channel < lv2_channels; channel ++)
+    {
+        float * get = data + channel;
+        float * in = channel_bufs[channel].begin ();
+        float * in_end = in + frames;
+
+        while (in < in_end)
+        {
+            * in ++ = * get;
+            get += lv2_channels;
+        }
+    }
+
+    run_block (frames);
+
+    for (int channel = 0; channel < lv2_channels; channel ++)
+    {
+        float * set = data + channel;
+        float * out = channel_bufs[channel].begin ();
+        float * out_end = out + frames;
+
+        while (out < out_end)
+        {
+            * set = * out ++;
+            set += lv2_channels;
+        }
+    }
+}
+
+/* fills the output FIFO with one block of silence, which is the delay */
+static void reset_fifos ()
+{
+    int block_samples = LV2_BUFLEN * lv2_channels;
+
+    fifo_in.discard ();
+    fifo_out.discard ();
+
+    if (fifo_out.size () < block_samples)
+        fifo_out.alloc (block_samples);
+
+    memset (block.begin (), 0, sizeof (float) * block_samples);
+    fifo_out.copy_in (block.begin (), block_samples);
+}
+
+static void run_fixed (float * data, int samples)
+{
+    int block_samples = LV2_BUFLEN * lv2_channels;
+
+    /* the FIFOs together never hold more than one block besides the new data */
+    int needed = block_samples + samples;
+
+    if (fifo_in.size () < needed)
+        fifo_in.alloc (needed);
+    if (fifo_out.size () < needed)
+        fifo_out.alloc (needed);
+
+    fifo_in.copy_in (data, samples);
+
+    while (fifo_in.len () >= block_samples)
+    {
+        fifo_in.move_out (block.begin (), block_samples);
+        run_frames (block.begin (), LV2_BUFLEN);
+        fifo_out.copy_in (block.begin (), block_samples);
+    }
+
+    fifo_out.move_out (data, samples);
+}
+
+static void run_chain (float * data, int samples)
+{
+    bool any_active = false;
+    bool need_fixed = false;
+
+    for (auto & loaded : loadeds)
+    {
+        start_plugin (* loaded);
+        if (loaded->instances.len ())
+        {
+            any_active = true;
+            if (loaded->plugin.fixed_block)
+                need_fixed = true;
+        }
+    }
+
+    if (need_fixed != fixed_mode)
+    {
+        fixed_mode = need_fixed;
+        if (fixed_mode)
+            reset_fifos ();
+    }
+
+    if (fixed_mode)
+        run_fixed (data, samples);
+    else if (any_active)
+    {
+        while (samples / lv2_channels > 0)
+        {
+            int frames = aud::min (samples / lv2_channels, LV2_BUFLEN);
+
+            run_frames (data, frames);
+
+            data += lv2_channels * frames;
+            samples -= lv2_channels * frames;
+        }
+    }
+}
+
+/* pushes the last block through the chain at the end of a song */
+static void drain_fifos (Index<float> & data)
+{
+    int block_samples = LV2_BUFLEN * lv2_channels;
+    int remaining = fifo_in.len ();
+
+    if (fifo_out.size () < 2 * block_samples)
+        fifo_out.alloc (2 * block_samples);
+
+    if (remaining)
+    {
+        fifo_in.move_out (block.begin (), remaining);
+        memset (block.begin () + remaining, 0, sizeof (float) * (block_samples - remaining));
+        run_frames (block.begin (), LV2_BUFLEN);
+        fifo_out.copy_in (block.begin (), block_samples);
+    }
+
+    data.insert (-1, block_samples);
+    fifo_out.move_out (data.end () - block_samples, block_samples);
+
+    reset_fifos ();
+}
+
+static void flush_plugin (LoadedPlugin & loaded)
+{
+    for (auto & inst : loaded.instances)
+    {
+        lilv_instance_deactivate (inst->instance);
+        lilv_instance_activate (inst->instance);
+    }
+}
+
+void shutdown_plugin_locked (LoadedPlugin & loaded)
+{
+    loaded.active = 0;
+    free_instances (loaded);
+}
+
+void LV2Host::start (int & channels, int & rate)
+{
+    pthread_mutex_lock (& mutex);
+
+    for (auto & loaded : loadeds)
+        shutdown_plugin_locked (* loaded);
+
+    lv2_channels = channels;
+    lv2_rate = rate;
+
+    atom_chunk = map_uri (LV2_ATOM__Chunk);
+    atom_sequence = map_uri (LV2_ATOM__Sequence);
+
+    channel_bufs.clear ();
+    channel_bufs.insert (0, channels);
+    for (auto & buf : channel_bufs)
+        buf.insert (0, LV2_BUFLEN);
+
+    block.resize (LV2_BUFLEN * channels);
+    fifo_in.discard ();
+    fifo_out.discard ();
+    fixed_mode = false;
+
+    pthread_mutex_unlock (& mutex);
+}
+
+Index<float> & LV2Host::process (Index<float> & data)
+{
+    pthread_mutex_lock (& mutex);
+
+    run_chain (data.begin (), data.len ());
+
+    pthread_mutex_unlock (& mutex);
+    return data;
+}
+
+bool LV2Host::flush (bool force)
+{
+    pthread_mutex_lock (& mutex);
+
+    for (auto & loaded : loadeds)
+        flush_plugin (* loaded);
+
+    if (fixed_mode)
+        reset_fifos ();
+
+    pthread_mutex_unlock (& mutex);
+    return true;
+}
+
+Index<float> & LV2Host::finish (Index<float> & data, bool end_of_playlist)
+{
+    pthread_mutex_lock (& mutex);
+
+    run_chain (data.begin (), data.len ());
+
+    if (fixed_mode)
+        drain_fifos (data);
+
+    if (end_of_playlist)
+    {
+        for (auto & loaded : loadeds)
+            shutdown_plugin_locked (* loaded);
+    }
+
+    pthread_mutex_unlock (& mutex);
+    return data;
+}
+
+int LV2Host::adjust_delay (int delay)
+{
+    if (! fixed_mode)
+        return delay;
+
+    return delay + aud::rescale (LV2_BUFLEN, lv2_rate, 1000);
+}
@@ -0,0 +1,189 @@
+/*
+ * LV2 Host for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Based on the LADSPA Host:
+ * Copyright 2011 John Lindgren
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef AUD_LV2_PLUGIN_H
+#define AUD_LV2_PLUGIN_H
+
+#include <atomic>
+#include <pthread.h>
+#include <gtk/gtk.h>
+
+#include <lilv/lilv.h>
+#include <lv2/core/lv2.h>
+#include <lv2/options/options.h>
+#include <lv2/urid/urid.h>
+#include <lv2/worker/worker.h>
+
+#include <libaudcore/i18n.h>
+#include <libaudcore/plugin.h>
+
+/* maximum (and nominal) number of frames per run */
+#define LV2_BUFLEN 1024
+
+/* size of the buffer for each atom port */
+#define LV2_ATOM_BUFLEN 8192
+
+struct PreferencesWidget;
+
+struct ControlData {
+    int port;
+    String name;
+    bool is_toggle;
+    float min, max, def;
+};
+
+struct PluginData
+{
+    String uri;
+    String name;
+    const LilvPlugin * lilv;
+    Index<ControlData> controls;
+    Index<int> in_ports, out_ports;
+    Index<int> atom_in_ports, atom_out_ports;
+    Index<int> scratch_ports;  /* control outputs and CV ports */
+    bool fixed_block = false;  /* needs exactly LV2_BUFLEN frames per run */
+    bool in_place_broken = false;
+    bool has_worker = false;
+    bool selected = false;
+
+    PluginData (const char * uri, const char * name, const LilvPlugin * lilv) :
+        uri (uri),
+        name (name),
+        lilv (lilv) {}
+};
+
+/* single-producer, single-consumer byte queue used by the worker extension,
+ * so that neither side has to allocate or lock in the audio thread */
+struct WorkRing
+{
+    Index<char> buf;  /* power of two size, allocated up front */
+    std::atomic<uint32_t> read {0}, write {0};
+};
+
+struct InstanceData
+{
+    LilvInstance * instance = nullptr;
+    const LV2_Worker_Interface * worker = nullptr;
+    LV2_Worker_Schedule schedule {};
+    LV2_Feature schedule_feature {};
+    int32_t block_lengths[3] {};  /* minimum, maximum, nominal */
+    float sample_rate = 0;
+    LV2_Options_Option options[5] {};
+    LV2_Feature options_feature {};
+    Index<const LV2_Feature *> features;
+    Index<Index<char>> atom_bufs;  /* inputs first, then outputs */
+    Index<float> scratch;
+    WorkRing responses;  /* from the worker thread */
+    Index<char> response;  /* the one being delivered */
+};
+
+struct LoadedPlugin
+{
+    PluginData & plugin;
+    Index<float> values;
+    bool selected = false;
+    bool active = false;
+    Index<SmartPtr<InstanceData>> instances;
+    Index<Index<float>> out_bufs;  /* only if in-place processing is broken */
+    GtkWidget * settings_win = nullptr;
+
+    LoadedPlugin (PluginData & plugin) :
+        plugin (plugin) {}
+};
+
+class LV2Host : public EffectPlugin
+{
+public:
+    static const char about[];
+    static const char * const defaults[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
+
+    static constexpr PluginInfo info = {
+        N_("LV2 Host"),
+        PACKAGE,
+        about,
+        & prefs
+    };
+
+    constexpr LV2Host () : EffectPlugin (info, 0, true) {}
+
+    bool init () override;
+    void cleanup () override;
+
+    void start (int & channels, int & rate) override;
+    Index<float> & process (Index<float> & data) override;
+    bool flush (bool force) override;
+    Index<float> & finish (Index<float> & data, bool end_of_playlist) override;
+    int adjust_delay (int delay) override;
+};
+
+/* plugin.cc */
+
+/* The mutex needs to be locked when the main thread is writing to the data
+ * structures below (but not when it is only reading from them) and when the
+ * audio thread is reading from them. */
+
+extern pthread_mutex_t mutex;
+extern LilvWorld * world;
+extern Index<SmartPtr<PluginData>> plugins;
+extern Index<SmartPtr<LoadedPlugin>> loadeds;
+
+extern GtkWidget * plugin_list;
+extern GtkWidget * loaded_list;
+
+LoadedPlugin & enable_plugin_locked (PluginData & plugin);
+void disable_plugin_locked (LoadedPlugin & loaded);
+
+/* urid.cc */
+
+extern LV2_URID_Map urid_map;
+extern LV2_URID_Unmap urid_unmap;
+
+LV2_URID map_uri (const char * uri);
+void clear_uris ();
+
+/* worker.cc */
+
+void start_worker ();
+void stop_worker ();
+void prepare_worker (InstanceData & instance);
+void forget_instance (InstanceData & instance);
+void deliver_responses (InstanceData & instance);
+LV2_Worker_Status schedule_work (LV2_Worker_Schedule_Handle handle,
+ uint32_t size, const void * data);
+
+/* effect.cc */
+
+void shutdown_plugin_locked (LoadedPlugin & loaded);
+
+/* plugin-list.cc */
+
+GtkWidget * create_plugin_list ();
+void update_plugin_list (GtkWidget * list);
+
+/* loaded-list.cc */
+
+GtkWidget * create_loaded_list ();
+void update_loaded_list (GtkWidget * list);
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * LV2 Host for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Based on the LADSPA Host:
+ * Copyright 2011 John Lindgren
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+
+#include <libaudcore/multihash.h>
+
+#include "plugin.h"
+
+/* URIs are mapped to consecutive numbers starting at 1, so that unmapping is
+ * a simple lookup.  Plugins may call these from any thread. */
+
+static pthread_mutex_t urid_mutex = PTHREAD_MUTEX_INITIALIZER;
+static SimpleHash<String, LV2_URID> urids;
+static Index<String> uris;
+
+LV2_URID map_uri (const char * uri)
+{
+    pthread_mutex_lock (& urid_mutex);
+
+    String key (uri);
+    LV2_URID * urid = urids.lookup (key);
+
+    if (! urid)
+    {
+        uris.append (key);
+        urid = urids.add (key, (LV2_URID) uris.len ());
+    }
+
+    LV2_URID result = * urid;
+
+    pthread_mutex_unlock (& urid_mutex);
+    return result;
+}
+
+static LV2_URID map_uri_cb (LV2_URID_Map_Handle, const char * uri)
+{
+    return map_uri (uri);
+}
+
+static const char * unmap_uri_cb (LV2_URID_Unmap_Handle, LV2_URID urid)
+{
+    pthread_mutex_lock (& urid_mutex);
+    const char * uri = (urid > 0 && urid <= (LV2_URID) uris.len ()) ? (const char *) uris[urid - 1] : nullptr;
+    pthread_mutex_unlock (& urid_mutex);
+
+    return uri;
+}
+
+void clear_uris ()
+{
+    pthread_mutex_lock (& urid_mutex);
+    urids.clear ();
+    uris.clear ();
+    pthread_mutex_unlock (& urid_mutex);
+}
+
+LV2_URID_Map urid_map = {nullptr, map_uri_cb};
+LV2_URID_Unmap urid_unmap = {nullptr, unmap_uri_cb};
@@ -0,0 +1,274 @@
+/*
+ * LV2 Host for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Based on the LADSPA Host:
+ * Copyright 2011 John Lindgren
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+
+#include <semaphore.h>
+#include <string.h>
+
+#include <libaudcore/runtime.h>
+
+#include "plugin.h"
+
+/* Plugins implementing the worker extension schedule non-realtime jobs (such
+ * as loading files) from run().  The jobs are done on a single background
+ * thread; the responses are queued per instance and handed back to the
+ * plugin in the audio thread after its next run().  Both queues are
+ * preallocated rings, so the audio thread never allocates or waits on a lock
+ * here. */
+
+#define REQUEST_RING_SIZE 65536
+#define RESPONSE_RING_SIZE 16384
+
+struct RequestHeader
+{
+    InstanceData * instance;
+    uint32_t size;
+};
+
+static pthread_t worker;
+static std::atomic<bool> worker_running;
+static bool worker_quit;
+static sem_t work_sem;  /* counts the queued requests */
+static pthread_mutex_t work_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+
+static WorkRing requests;
+static Index<char> request;  /* the one being worked on */
+static InstanceData * working_on, * forgetting;
+
+static void ring_copy_in (WorkRing & ring, uint32_t pos, const void * data, uint32_t size)
+{
+    uint32_t len = ring.buf.len ();
+    uint32_t offset = pos & (len - 1);
+    uint32_t first = aud::min (size, len - offset);
+
+    memcpy (& ring.buf[offset], data, first);
+    memcpy (ring.buf.begin (), (const char *) data + first, size - first);
+}
+
+static void ring_copy_out (WorkRing & ring, uint32_t pos, void * data, uint32_t size)
+{
+    uint32_t len = ring.buf.len ();
+    uint32_t offset = pos & (len - 1);
+    uint32_t first = aud::min (size, len - offset);
+
+    memcpy (data, & ring.buf[offset], first);
+    memcpy ((char *) data + first, ring.buf.begin (), size - first);
+}
+
+/* called only by the producer; fails if there is not enough space */
+static bool ring_write (WorkRing & ring, const void * head, uint32_t head_size,
+ const void * data, uint32_t size)
+{
+    uint32_t write = ring.write.load (std::memory_order_relaxed);
+    uint32_t read = ring.read.load (std::memory_order_acquire);
+
+    if (head_size + size > ring.buf.len () - (write - read))
+        return false;
+
+    ring_copy_in (ring, write, head, head_size);
+    ring_copy_in (ring, write + head_size, data, size);
+
+    ring.write.store (write + head_size + size, std::memory_order_release);
+    return true;
+}
+
+static LV2_Worker_Status respond (LV2_Worker_Respond_Handle handle,
+ uint32_t size, const void * data)
+{
+    auto instance = (InstanceData *) handle;
+
+    if (size > RESPONSE_RING_SIZE - sizeof (uint32_t) ||
+     ! ring_write (instance->responses, & size, sizeof size, data, size))
+        return LV2_WORKER_ERR_NO_SPACE;
+
+    return LV2_WORKER_SUCCESS;
+}
+
+static void * worker_thread (void *)
+{
+    while (true)
+    {
+        if (sem_wait (& work_sem) < 0)
+            continue;  /* interrupted */
+
+        pthread_mutex_lock (& work_mutex);
+
+        if (worker_quit)
+            break;
+
+        uint32_t read = requests.read.load (std::memory_order_relaxed);
+
+        RequestHeader head;
+        ring_copy_out (requests, read, & head, sizeof head);
+        ring_copy_out (requests, read + sizeof head, request.begin (), head.size);
+
+        requests.read.store (read + sizeof head + head.size, std::memory_order_release);
+
+        bool skip = (head.instance == forgetting);
+        if (! skip)
+            working_on = head.instance;
+
+        pthread_mutex_unlock (& work_mutex);
+
+        if (! skip)
+        {
+            InstanceData & instance = * head.instance;
+            instance.worker->work (lilv_instance_get_handle (instance.instance),
+             respond, & instance, head.size, request.begin ());
+        }
+
+        pthread_mutex_lock (& work_mutex);
+
+        working_on = nullptr;
+        pthread_cond_broadcast (& idle_cond);
+
+        pthread_mutex_unlock (& work_mutex);
+    }
+
+    pthread_mutex_unlock (& work_mutex);
+    return nullptr;
+}
+
+LV2_Worker_Status schedule_work (LV2_Worker_Schedule_Handle handle,
+ uint32_t size, const void * data)
+{
+    auto instance = (InstanceData *) handle;
+
+    if (! worker_running.load (std::memory_order_acquire) || ! instance->worker)
+        return LV2_WORKER_ERR_UNKNOWN;
+
+    RequestHeader head = {instance, size};
+
+    if (size > REQUEST_RING_SIZE - sizeof head ||
+     ! ring_write (requests, & head, sizeof head, data, size))
+        return LV2_WORKER_ERR_NO_SPACE;
+
+    sem_post (& work_sem);
+    return LV2_WORKER_SUCCESS;
+}
+
+void deliver_responses (InstanceData & instance)
+{
+    if (! instance.worker)
+        return;
+
+    WorkRing & ring = instance.responses;
+    LV2_Handle handle = lilv_instance_get_handle (instance.instance);
+
+    uint32_t read = ring.read.load (std::memory_order_relaxed);
+    uint32_t write = ring.write.load (std::memory_order_acquire);
+
+    while (read != write)
+    {
+        uint32_t size;
+        ring_copy_out (ring, read, & size, sizeof size);
+        ring_copy_out (ring, read + sizeof size, instance.response.begin (), size);
+
+        read += sizeof size + size;
+        ring.read.store (read, std::memory_order_release);
+
+        instance.worker->work_response (handle, size, instance.response.begin ());
+    }
+
+    if (instance.worker->end_run)
+        instance.worker->end_run (handle);
+}
+
+/* allocates the response queue; called before the instance is created */
+void prepare_worker (InstanceData & instance)
+{
+    instance.responses.buf.insert (0, RESPONSE_RING_SIZE);
+    instance.response.insert (0, RESPONSE_RING_SIZE);
+}
+
+/* drops all pending jobs of an instance and waits until the worker thread is
+ * done with it, so that it can be freed */
+void forget_instance (InstanceData & instance)
+{
+    pthread_mutex_lock (& work_mutex);
+
+    /* every request queued so far has to pass through the worker thread,
+     * which skips the ones for this instance */
+    uint32_t target = requests.write.load (std::memory_order_acquire);
+    forgetting = & instance;
+
+    while ((worker_running && (int32_t) (requests.read - target) < 0) ||
+     working_on == & instance)
+        pthread_cond_wait (& idle_cond, & work_mutex);
+
+    forgetting = nullptr;
+
+    pthread_mutex_unlock (& work_mutex);
+
+    instance.responses.read = 0;
+    instance.responses.write = 0;
+}
+
+void start_worker ()
+{
+    pthread_mutex_lock (& work_mutex);
+
+    if (! worker_running)
+    {
+        worker_quit = false;
+
+        if (! requests.buf.len ())
+        {
+            requests.buf.insert (0, REQUEST_RING_SIZE);
+            request.insert (0, REQUEST_RING_SIZE);
+        }
+
+        requests.read = 0;
+        requests.write = 0;
+        sem_init (& work_sem, 0, 0);
+
+        if (pthread_create (& worker, nullptr, worker_thread, nullptr))
+        {
+            AUDERR ("Failed to create worker thread.\n");
+            sem_destroy (& work_sem);
+        }
+        else
+            worker_running = true;
+    }
+
+    pthread_mutex_unlock (& work_mutex);
+}
+
+void stop_worker ()
+{
+    pthread_mutex_lock (& work_mutex);
+
+    bool running = worker_running;
+    worker_quit = true;
+    worker_running = false;
+    pthread_cond_broadcast (& idle_cond);
+
+    pthread_mutex_unlock (& work_mutex);
+
+    if (running)
+    {
+        sem_post (& work_sem);
+        pthread_join (worker, nullptr);
+        sem_destroy (& work_sem);
+    }
+}
@@ -17,20 +17,32 @@
  * the use of this software.
  */
 
-/* TODO: implement more surround converters.
-         There should be more options for in * out cases (for example,
+/* TODO: There should be more options for in * out cases (for example,
          the user may wish to mix stereo up to quadro but keep 5.1 as-is,
          rather than downmixing 5.1 to quadro). A possible design might
          be a choice of output channels for each input channel count that
          we care about. */
 
+/* Every conversion is an output x input matrix of coefficients.  The matrix
+ * is built from the speaker layouts of the input and output (or taken from
+ * the user's settings) and stored as a list of its non-zero terms, which are
+ * applied to blocks of deinterleaved audio with the shared DSP kernels. */
+
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
 
+#include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/dsp.h"
+#include "../effect-common/profiler.h"
+
 class ChannelMixer : public EffectPlugin
 {
 public:
@@ -56,188 +68,398 @@ public:
     Index<float> & process (Index<float> & data) override;
 };
 
-EXPORT ChannelMixer aud_plugin_instance;
+EXPORT PROFILED (ChannelMixer) aud_plugin_instance;
+
+enum {
+    PRESET_ITU,
+    PRESET_DOLBY,
+    PRESET_LEGACY,
+    PRESET_CUSTOM
+};
+
+/* speaker positions */
+enum Speaker {
+    FL, FR, FC, LFE,
+    BL, BR,  /* back, only in 7.1 */
+    SL, SR,  /* side or rear */
+    BC,      /* back center, only in 6.1 */
+    NONE
+};
+
+#define MAX_LAYOUT 8
+#define BLOCK_FRAMES 256
+
+/* -3 dB, for folding one speaker into two, or two into one */
+#define MIX_LEVEL 0.70710678f
+
+/* Dolby Pro Logic II encoding of the surround channels */
+#define PL2_HIGH 0.8718f
+#define PL2_LOW 0.4899f
+
+static const Speaker layouts[MAX_LAYOUT + 1][MAX_LAYOUT] = {
+    {NONE},
+    {FC},
+    {FL, FR},
+    {FL, FR, FC},
+    {FL, FR, SL, SR},
+    {FL, FR, FC, SL, SR},
+    {FL, FR, FC, LFE, SL, SR},
+    {FL, FR, FC, LFE, BC, SL, SR},
+    {FL, FR, FC, LFE, BL, BR, SL, SR}
+};
+
+struct LegacyMatrix {
+    int in, out;
+    float coefs[4][6];
+};
+
+/* the coefficients of the converters in earlier versions of this plugin */
+static const LegacyMatrix legacy_matrices[] = {
+    {1, 2, {{1}, {1}}},
+    {2, 1, {{0.5, 0.5}}},
+    {2, 4, {{1, 0}, {0, 1}, {1, 0}, {0, 1}}},
+    {4, 2, {{1, 0, 0.7, 0}, {0, 1, 0, 0.7}}},
+    {5, 2, {{1, 0, 0.5, 1, 0}, {0, 1, 0.5, 0, 1}}},
+    {6, 2, {{1, 0, 0.5, 0.5, 0.5, 0}, {0, 1, 0.5, 0.5, 0, 0.5}}}
+};
+
+struct MixTerm {
+    int out, in;
+    float gain;
+};
 
-typedef Index<float> & (* Converter) (Index<float> & data);
+static int input_channels, output_channels;
+static float matrix[AUD_MAX_CHANNELS][AUD_MAX_CHANNELS];  /* [out][in] */
+static Index<MixTerm> terms;
+static bool passthrough;
+
+static std::atomic<bool> settings_dirty (false);
 
+static float in_planes[AUD_MAX_CHANNELS][BLOCK_FRAMES];
+static float out_planes[AUD_MAX_CHANNELS][BLOCK_FRAMES];
 static Index<float> mixer_buf;
 
-static Index<float> & mono_to_stereo (Index<float> & data)
+static void settings_changed ()
 {
-    int frames = data.len ();
-    mixer_buf.resize (2 * frames);
+    settings_dirty = true;
+}
 
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
+static int find_speaker (int channels, Speaker speaker)
+{
+    if (channels > MAX_LAYOUT)
+        return -1;
 
-    while (frames --)
+    for (int i = 0; i < channels; i ++)
     {
-        float val = * get ++;
-        * set ++ = val;
-        * set ++ = val;
+        if (layouts[channels][i] == speaker)
+            return i;
     }
 
-    return mixer_buf;
+    return -1;
 }
 
-static Index<float> & stereo_to_mono (Index<float> & data)
+static bool has_speaker (int channels, Speaker speaker)
 {
-    int frames = data.len () / 2;
-    mixer_buf.resize (frames);
+    return find_speaker (channels, speaker) >= 0;
+}
 
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
+/* adds input channel <in> to the output as <speaker>, folding it into the
+ * nearest speakers if the output does not have that one */
+static void place (int in, Speaker speaker, float gain)
+{
+    int out = find_speaker (output_channels, speaker);
+    if (out >= 0)
+    {
+        matrix[out][in] += gain;
+        return;
+    }
 
-    while (frames --)
+    switch (speaker)
+    {
+    case FC:
+        place (in, FL, gain * MIX_LEVEL);
+        place (in, FR, gain * MIX_LEVEL);
+        break;
+    case FL:
+    case FR:
+        place (in, FC, gain * MIX_LEVEL);
+        break;
+    case BL:
+    case SL:
+    {
+        Speaker other = (speaker == BL) ? SL : BL;
+        if (has_speaker (output_channels, other))
+            place (in, other, gain);
+        else
+            place (in, FL, gain * MIX_LEVEL);
+        break;
+    }
+    case BR:
+    case SR:
     {
-        float val = * get ++;
-        val += * get ++;
-        * set ++ = val / 2;
+        Speaker other = (speaker == BR) ? SR : BR;
+        if (has_speaker (output_channels, other))
+            place (in, other, gain);
+        else
+            place (in, FR, gain * MIX_LEVEL);
+        break;
     }
+    case BC:
+        place (in, SL, gain * MIX_LEVEL);
+        place (in, SR, gain * MIX_LEVEL);
+        break;
+    default:
+        /* the LFE channel is dropped, as recommended by ITU-R BS.775 */
+        break;
+    }
+}
 
-    return mixer_buf;
+static void build_itu ()
+{
+    if (input_channels > MAX_LAYOUT || output_channels > MAX_LAYOUT)
+    {
+        /* unknown layout, keep the channels that both sides have */
+        for (int c = 0; c < aud::min (input_channels, output_channels); c ++)
+            matrix[c][c] = 1;
+        return;
+    }
+
+    for (int in = 0; in < input_channels; in ++)
+        place (in, layouts[input_channels][in], 1);
 }
 
-static Index<float> & quadro_to_stereo (Index<float> & data)
+/* matrix-encoded stereo (Lt/Rt) that a Pro Logic II decoder can unfold */
+static bool build_dolby ()
 {
-    int frames = data.len () / 4;
-    mixer_buf.resize (2 * frames);
+    if (output_channels != 2 || input_channels > MAX_LAYOUT)
+        return false;
 
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
+    bool side_and_back = has_speaker (input_channels, SL) &&
+     has_speaker (input_channels, BL);
+    float surround = side_and_back ? MIX_LEVEL : 1;
 
-    while (frames --)
+    for (int in = 0; in < input_channels; in ++)
     {
-        float front_left  = * get ++;
-        float front_right = * get ++;
-        float back_left   = * get ++;
-        float back_right  = * get ++;
-        * set ++ = front_left + (back_left * 0.7);
-        * set ++ = front_right + (back_right * 0.7);
+        switch (layouts[input_channels][in])
+        {
+        case FL:
+            matrix[0][in] = 1;
+            break;
+        case FR:
+            matrix[1][in] = 1;
+            break;
+        case FC:
+            matrix[0][in] = matrix[1][in] = MIX_LEVEL;
+            break;
+        case SL:
+        case BL:
+            matrix[0][in] = -PL2_HIGH * surround;
+            matrix[1][in] = PL2_LOW * surround;
+            break;
+        case SR:
+        case BR:
+            matrix[0][in] = -PL2_LOW * surround;
+            matrix[1][in] = PL2_HIGH * surround;
+            break;
+        case BC:
+            matrix[0][in] = -MIX_LEVEL;
+            matrix[1][in] = MIX_LEVEL;
+            break;
+        default:
+            break;
+        }
     }
 
-    return mixer_buf;
+    return true;
 }
 
-static Index<float> & stereo_to_quadro (Index<float> & data)
+static bool build_legacy ()
 {
-    int frames = data.len () / 2;
-    mixer_buf.resize (4 * frames);
+    for (const LegacyMatrix & legacy : legacy_matrices)
+    {
+        if (legacy.in != input_channels || legacy.out != output_channels)
+            continue;
 
-    float * get = data.begin ();
-    float * set = mixer_buf.begin();
+        for (int out = 0; out < output_channels; out ++)
+        {
+            for (int in = 0; in < input_channels; in ++)
+                matrix[out][in] = legacy.coefs[out][in];
+        }
 
-    while (frames --)
-    {
-        float left  = * get ++;
-        float right = * get ++;
-        * set ++ = left;   // front left
-        * set ++ = right;  // front right
-        * set ++ = left;   // rear left
-        * set ++ = right;  // rear right
+        return true;
     }
 
-    return mixer_buf;
+    return false;
 }
 
-static Index<float> & surround_5p1_to_stereo (Index<float> & data)
+/* one row per output channel, separated by semicolons, with one coefficient
+ * per input channel, separated by commas or spaces */
+static bool build_custom ()
 {
-    int frames = data.len () / 6;
-    mixer_buf.resize (2 * frames);
+    String text = aud_get_str ("mixer", "custom_matrix");
+    Index<String> rows = str_list_to_index (text, ";");
 
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
+    if (rows.len () != output_channels)
+        return false;
+
+    for (int out = 0; out < output_channels; out ++)
+    {
+        Index<String> coefs = str_list_to_index (rows[out], ", ");
 
-    while (frames --)
+        if (coefs.len () != input_channels)
+            return false;
+
+        for (int in = 0; in < input_channels; in ++)
+            matrix[out][in] = str_to_double (coefs[in]);
+    }
+
+    return true;
+}
+
+/* scales the matrix so that no output can exceed full scale */
+static void normalize_matrix ()
+{
+    float max_sum = 0;
+
+    for (int out = 0; out < output_channels; out ++)
     {
-        float front_left  = * get ++;
-        float front_right = * get ++;
-        float center = * get ++;
-        float lfe    = * get ++;
-        float rear_left   = * get ++;
-        float rear_right  = * get ++;
-        * set ++ = front_left + (center * 0.5) + (lfe * 0.5) + (rear_left * 0.5);
-        * set ++ = front_right + (center * 0.5) + (lfe * 0.5) + (rear_right * 0.5);
+        float sum = 0;
+        for (int in = 0; in < input_channels; in ++)
+            sum += fabsf (matrix[out][in]);
+
+        max_sum = aud::max (max_sum, sum);
     }
 
-    return mixer_buf;
+    if (max_sum <= 1)
+        return;
+
+    for (int out = 0; out < output_channels; out ++)
+    {
+        for (int in = 0; in < input_channels; in ++)
+            matrix[out][in] /= max_sum;
+    }
 }
 
-/* 5 channels case. Quad + center channel */
-static Index<float> & quadro_5_to_stereo (Index<float> & data)
+static void update_matrix ()
 {
-    int frames = data.len () / 5;
-    mixer_buf.resize (2 * frames);
+    memset (matrix, 0, sizeof matrix);
 
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
+    int preset = aud_get_int ("mixer", "preset");
+    bool built = false;
 
-    while (frames --)
+    if (preset == PRESET_CUSTOM)
     {
-        float front_left  = * get ++;
-        float front_right = * get ++;
-        float center = * get ++;
-        float rear_left   = * get ++;
-        float rear_right  = * get ++;
-        * set ++ = front_left + (center * 0.5) + rear_left;
-        * set ++ = front_right + (center * 0.5) + rear_right;
+        built = build_custom ();
+        if (! built)
+        {
+            memset (matrix, 0, sizeof matrix);
+            AUDWARN ("Custom matrix does not fit %d to %d channels, "
+             "using the standard one.\n", input_channels, output_channels);
+        }
     }
+    else if (preset == PRESET_LEGACY)
+        built = build_legacy ();
+    else if (preset == PRESET_DOLBY)
+        built = build_dolby ();
 
-    return mixer_buf;
+    if (! built)
+        build_itu ();
+
+    /* the legacy tables and custom matrices keep their levels, but the
+     * standard matrix used in their place for other layouts can clip */
+    bool normalize = aud_get_bool ("mixer", "normalize");
+
+    if (preset == PRESET_LEGACY)
+        normalize = ! built;
+    else if (preset == PRESET_CUSTOM && built)
+        normalize = false;
+
+    if (normalize)
+        normalize_matrix ();
+
+    terms.clear ();
+    passthrough = (input_channels == output_channels);
+
+    for (int out = 0; out < output_channels; out ++)
+    {
+        for (int in = 0; in < input_channels; in ++)
+        {
+            float gain = matrix[out][in];
+
+            if (gain != (in == out ? 1 : 0))
+                passthrough = false;
+            if (gain != 0)
+                terms.append (MixTerm {out, in, gain});
+        }
+    }
 }
 
-static Converter get_converter (int in, int out)
+static void mix_block (const float * data, float * out, int frames)
 {
-    if (in == 1 && out == 2)
-        return mono_to_stereo;
-    if (in == 2 && out == 1)
-        return stereo_to_mono;
-    if (in == 2 && out == 4)
-        return stereo_to_quadro;
-    if (in == 4 && out == 2)
-        return quadro_to_stereo;
-    if (in == 5 && out == 2)
-        return quadro_5_to_stereo;
-    if (in == 6 && out == 2)
-        return surround_5p1_to_stereo;
-
-    return nullptr;
-}
+    for (int c = 0; c < input_channels; c ++)
+    {
+        const float * get = data + c;
+        for (int f = 0; f < frames; f ++, get += input_channels)
+            in_planes[c][f] = * get;
+    }
 
-static int input_channels, output_channels;
+    for (int c = 0; c < output_channels; c ++)
+        memset (out_planes[c], 0, sizeof (float) * frames);
+
+    for (const MixTerm & term : terms)
+        dsp_mac (out_planes[term.out], out_planes[term.out],
+         in_planes[term.in], term.gain, frames);
+
+    for (int c = 0; c < output_channels; c ++)
+    {
+        float * set = out + c;
+        for (int f = 0; f < frames; f ++, set += output_channels)
+            * set = out_planes[c][f];
+    }
+}
 
 void ChannelMixer::start (int & channels, int & rate)
 {
     input_channels = channels;
-    output_channels = aud_get_int ("mixer", "channels");
+    output_channels = aud::clamp (aud_get_int ("mixer", "channels"), 1, AUD_MAX_CHANNELS);
 
-    if (input_channels == output_channels)
-        return;
-
-    if (! get_converter (input_channels, output_channels))
-    {
-        AUDERR ("Converting %d to %d channels is not implemented.\n",
-         input_channels, output_channels);
-        return;
-    }
+    settings_dirty = false;
+    update_matrix ();
 
     channels = output_channels;
 }
 
 Index<float> & ChannelMixer::process (Index<float> & data)
 {
-    if (input_channels == output_channels)
+    if (settings_dirty.exchange (false))
+        update_matrix ();
+
+    if (passthrough)
         return data;
 
-    Converter converter = get_converter (input_channels, output_channels);
-    if (converter)
-        return converter (data);
+    int frames = data.len () / input_channels;
+    mixer_buf.resize (output_channels * frames);
+
+    const float * get = data.begin ();
+    float * set = mixer_buf.begin ();
+
+    while (frames > 0)
+    {
+        int block = aud::min (frames, BLOCK_FRAMES);
+        mix_block (get, set, block);
 
-    return data;
+        get += input_channels * block;
+        set += output_channels * block;
+        frames -= block;
+    }
+
+    return mixer_buf;
 }
 
 const char * const ChannelMixer::defaults[] = {
  "channels", "2",
+ "preset", aud::numeric_string<PRESET_LEGACY>::str,
+ "normalize", "TRUE",
   nullptr};
 
 bool ChannelMixer::init ()
@@ -249,17 +471,35 @@ bool ChannelMixer::init ()
 void ChannelMixer::cleanup ()
 {
     mixer_buf.clear ();
+    terms.clear ();
 }
 
 const char ChannelMixer::about[] =
  N_("Channel Mixer Plugin for Audacious\n"
     "Copyright 2011-2012 John Lindgren and Michał Lipski");
 
+static const ComboItem preset_items[] = {
+    ComboItem (N_("Standard (ITU-R BS.775)"), PRESET_ITU),
+    ComboItem (N_("Dolby Pro Logic II (stereo output)"), PRESET_DOLBY),
+    ComboItem (N_("Legacy"), PRESET_LEGACY),
+    ComboItem (N_("Custom"), PRESET_CUSTOM)
+};
+
 const PreferencesWidget ChannelMixer::widgets[] = {
     WidgetLabel (N_("<b>Channel Mixer</b>")),
     WidgetSpin (N_("Output channels:"),
         WidgetInt ("mixer", "channels"),
-        {1, AUD_MAX_CHANNELS, 1})
+        {1, AUD_MAX_CHANNELS, 1}),
+    WidgetCombo (N_("Coefficients:"),
+        WidgetInt ("mixer", "preset", settings_changed),
+        {{preset_items}}),
+    WidgetCheck (N_("Prevent clipping"),
+        WidgetBool ("mixer", "normalize", settings_changed)),
+    WidgetEntry (N_("Custom matrix:"),
+        WidgetString ("mixer", "custom_matrix", settings_changed)),
+    WidgetLabel (N_("<small>One row of coefficients per output channel, "
+        "separated by semicolons;\none coefficient per input channel, "
+        "separated by commas.</small>"))
 };
 
 const PluginPreferences ChannelMixer::prefs = {{widgets}};
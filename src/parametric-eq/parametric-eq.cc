@@ -0,0 +1,615 @@
+/*
+ * Parametric Equalizer Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+/* Each channel runs its own cascade of up to MAX_STAGES biquad filters.  The
+ * channels are processed in groups of LANES, with the coefficients and state of
+ * each stage stored as one vector per group, so that a single pass through the
+ * cascade filters all channels of a group at once.  The filters are computed
+ * in double precision, since narrow filters at low frequencies and high sample
+ * rates are too noisy in single precision.  When the filters change, the
+ * coefficients are interpolated towards their new values in small steps over
+ * RAMP_TIME to avoid audible clicks.
+ *
+ * The filter file is read and parsed on the main thread whenever it changes;
+ * the audio thread only swaps in the parsed filters and computes the new
+ * coefficients. */
+
+#include <math.h>
+#include <string.h>
+
+#include <atomic>
+#include <utility>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/i18n.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/runtime.h>
+#include <libaudcore/threads.h>
+#include <libaudcore/vfs.h>
+
+#include "../effect-common/profiler.h"
+
+#define MAX_STAGES 32
+#define LANES 4
+#define MAX_GROUPS ((AUD_MAX_CHANNELS + LANES - 1) / LANES)
+
+#define STEP_FRAMES 8 /* frames between coefficient updates */
+#define RAMP_TIME 20  /* milliseconds */
+
+typedef double Vector __attribute__ ((vector_size (LANES * sizeof (double))));
+
+enum {
+    FILTER_PEAK,
+    FILTER_LOW_SHELF,
+    FILTER_HIGH_SHELF,
+    FILTER_LOW_PASS,
+    FILTER_HIGH_PASS,
+    FILTER_NOTCH
+};
+
+struct Filter
+{
+    int type;
+    float freq, gain, q;
+};
+
+/* transposed direct form II, with a0 normalized to 1 */
+struct Stage
+{
+    Vector b0, b1, b2, a1, a2;
+    Vector z1, z2;
+};
+
+struct StageTarget
+{
+    Vector b0, b1, b2, a1, a2;
+};
+
+static const char eq_about[] =
+ N_("Parametric Equalizer Plugin for Audacious\n"
+    "Copyright 2026 Audacious developers\n\n"
+    "Applies up to 32 peaking, shelving, low-pass, high-pass and notch "
+    "filters per channel, read from a filter file in the format exported "
+    "by Room EQ Wizard and used by Equalizer APO:\n\n"
+    "Preamp: -6 dB\n"
+    "Channel: L R\n"
+    "Filter: ON PK Fc 50 Hz Gain -4.5 dB Q 2.0\n"
+    "Filter: ON LSC Fc 100 Hz Gain 3 dB Q 0.71\n"
+    "Filter: ON HP Fc 20 Hz");
+
+static const char * const eq_defaults[] = {
+    "filter_file", "",
+    nullptr
+};
+
+static void filters_changed ();
+
+static const PreferencesWidget eq_widgets[] = {
+    WidgetLabel (N_("<b>Filter File</b>")),
+    WidgetFileEntry (nullptr,
+        WidgetString ("parametric-eq", "filter_file", filters_changed),
+        {FileSelectMode::File})
+};
+
+static const PluginPreferences eq_prefs = {{eq_widgets}};
+
+class ParametricEQ : public EffectPlugin
+{
+public:
+    static constexpr PluginInfo info = {
+        N_("Parametric Equalizer"),
+        PACKAGE,
+        eq_about,
+        & eq_prefs
+    };
+
+    constexpr ParametricEQ () : EffectPlugin (info, 0, true) {}
+
+    bool init () override;
+    void cleanup () override;
+
+    void start (int & channels, int & rate) override;
+    Index<float> & process (Index<float> & data) override;
+    bool flush (bool force) override;
+};
+
+EXPORT PROFILED (ParametricEQ) aud_plugin_instance;
+
+static Index<Filter> filters[AUD_MAX_CHANNELS];
+static float preamp_db;
+
+/* parsed on the main thread, swapped with the ones above under the lock */
+static aud::mutex filters_lock;
+static std::atomic<bool> filters_dirty;
+static Index<Filter> new_filters[AUD_MAX_CHANNELS];
+static float new_preamp_db;
+
+static int current_channels, current_rate;
+
+static Stage stages[MAX_GROUPS][MAX_STAGES];
+static StageTarget targets[MAX_GROUPS][MAX_STAGES];
+static Vector gain[MAX_GROUPS], gain_target[MAX_GROUPS];
+static int active_stages[MAX_GROUPS];
+static int target_stages[MAX_GROUPS];
+static int ramp_left, step_pos;
+
+static int parse_channel (const char * name)
+{
+    static const char * const names[] =
+     {"L", "R", "C", "LFE", "RL", "RR", "SL", "SR"};
+
+    for (int i = 0; i < aud::n_elems (names); i ++)
+    {
+        if (! strcmp_nocase (name, names[i]))
+            return i;
+    }
+
+    if (! strcmp_nocase (name, "SUB"))
+        return 3;
+
+    int num = str_to_int (name);
+    return (num >= 1 && num <= AUD_MAX_CHANNELS) ? num - 1 : -1;
+}
+
+static bool parse_filter (const Index<String> & words, int pos, Filter & filter)
+{
+    static const struct {
+        const char * name;
+        int type;
+        float q;
+    } types[] = {
+        {"PK", FILTER_PEAK, 1},
+        {"PEQ", FILTER_PEAK, 1},
+        {"LS", FILTER_LOW_SHELF, M_SQRT1_2},
+        {"LSC", FILTER_LOW_SHELF, M_SQRT1_2},
+        {"HS", FILTER_HIGH_SHELF, M_SQRT1_2},
+        {"HSC", FILTER_HIGH_SHELF, M_SQRT1_2},
+        {"LP", FILTER_LOW_PASS, M_SQRT1_2},
+        {"LPQ", FILTER_LOW_PASS, M_SQRT1_2},
+        {"HP", FILTER_HIGH_PASS, M_SQRT1_2},
+        {"HPQ", FILTER_HIGH_PASS, M_SQRT1_2},
+        {"NO", FILTER_NOTCH, 30}
+    };
+
+    /* "Filter 1: ON PK Fc 50 Hz Gain -4.5 dB Q 2.0" */
+    if (pos < words.len () && str_to_int (words[pos]))
+        pos ++;
+
+    if (pos + 1 >= words.len () || strcmp_nocase (words[pos], "ON"))
+        return false;
+
+    const char * type = words[pos + 1];
+    bool found = false;
+
+    for (auto & t : types)
+    {
+        if (! strcmp_nocase (type, t.name))
+        {
+            filter = {t.type, 0, 0, t.q};
+            found = true;
+        }
+    }
+
+    if (! found)
+    {
+        AUDWARN ("Unknown filter type: %s\n", type);
+        return false;
+    }
+
+    for (pos += 2; pos + 1 < words.len (); pos ++)
+    {
+        if (! strcmp_nocase (words[pos], "Fc"))
+            filter.freq = str_to_double (words[++ pos]);
+        else if (! strcmp_nocase (words[pos], "Gain"))
+            filter.gain = str_to_double (words[++ pos]);
+        else if (! strcmp_nocase (words[pos], "Q"))
+            filter.q = str_to_double (words[++ pos]);
+    }
+
+    return filter.freq > 0 && filter.q > 0;
+}
+
+static void load_filters (const char * uri, Index<Filter> lists[], float & preamp)
+{
+    preamp = 0;
+
+    if (! uri[0])
+        return;
+
+    VFSFile file (uri, "r");
+    if (! file)
+    {
+        AUDERR ("Failed to open %s: %s.\n", uri, file.error ());
+        return;
+    }
+
+    Index<char> text = file.read_all ();
+    text.append (0);
+
+    int channel_mask = -1; /* all channels */
+
+    for (const String & line : str_list_to_index (text.begin (), "\r\n"))
+    {
+        auto words = str_list_to_index (line, " \t:");
+        if (! words.len () || words[0][0] == '#')
+            continue;
+
+        if (! strcmp_nocase (words[0], "Preamp") && words.len () >= 2)
+            preamp = str_to_double (words[1]);
+        else if (! strcmp_nocase (words[0], "Channel"))
+        {
+            channel_mask = 0;
+
+            for (int i = 1; i < words.len (); i ++)
+            {
+                int channel = parse_channel (words[i]);
+
+                if (! strcmp_nocase (words[i], "all"))
+                    channel_mask = -1;
+                else if (channel >= 0)
+                    channel_mask |= 1 << channel;
+            }
+        }
+        else if (! strcmp_nocase (words[0], "Filter"))
+        {
+            Filter filter;
+            if (! parse_filter (words, 1, filter))
+                continue;
+
+            for (int c = 0; c < AUD_MAX_CHANNELS; c ++)
+            {
+                if (! (channel_mask & (1 << c)))
+                    continue;
+
+                if (lists[c].len () < MAX_STAGES)
+                    lists[c].append (filter);
+                else
+                    AUDWARN ("Too many filters for channel %d.\n", c + 1);
+            }
+        }
+    }
+}
+
+/* main thread: reads the file and hands the filters to the audio thread */
+static void filters_changed ()
+{
+    Index<Filter> parsed[AUD_MAX_CHANNELS];
+    float preamp;
+
+    load_filters (aud_get_str ("parametric-eq", "filter_file"), parsed, preamp);
+
+    auto lh = filters_lock.take ();
+
+    for (int c = 0; c < AUD_MAX_CHANNELS; c ++)
+        new_filters[c] = std::move (parsed[c]);
+
+    new_preamp_db = preamp;
+    filters_dirty = true;
+}
+
+/* audio thread: swaps in the filters parsed last, if there are new ones; the
+ * old ones are freed on the main thread */
+static bool take_filters ()
+{
+    if (! filters_dirty)
+        return false;
+
+    auto lh = filters_lock.take ();
+
+    for (int c = 0; c < AUD_MAX_CHANNELS; c ++)
+        std::swap (filters[c], new_filters[c]);
+
+    preamp_db = new_preamp_db;
+    filters_dirty = false;
+    return true;
+}
+
+/* biquad coefficients from the Audio EQ Cookbook by Robert Bristow-Johnson */
+static void calc_coefs (const Filter & filter, double coefs[5])
+{
+    double freq = aud::min ((double) filter.freq, 0.499 * current_rate);
+    double w0 = 2 * M_PI * freq / current_rate;
+    double cosw = cos (w0);
+    double alpha = sin (w0) / (2 * filter.q);
+    double A = pow (10, filter.gain / 40);
+    double sqrtA2alpha = 2 * sqrt (A) * alpha;
+
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (filter.type)
+    {
+    case FILTER_PEAK:
+        b0 = 1 + alpha * A;
+        b1 = -2 * cosw;
+        b2 = 1 - alpha * A;
+        a0 = 1 + alpha / A;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha / A;
+        break;
+
+    case FILTER_LOW_SHELF:
+        b0 = A * ((A + 1) - (A - 1) * cosw + sqrtA2alpha);
+        b1 = 2 * A * ((A - 1) - (A + 1) * cosw);
+        b2 = A * ((A + 1) - (A - 1) * cosw - sqrtA2alpha);
+        a0 = (A + 1) + (A - 1) * cosw + sqrtA2alpha;
+        a1 = -2 * ((A - 1) + (A + 1) * cosw);
+        a2 = (A + 1) + (A - 1) * cosw - sqrtA2alpha;
+        break;
+
+    case FILTER_HIGH_SHELF:
+        b0 = A * ((A + 1) + (A - 1) * cosw + sqrtA2alpha);
+        b1 = -2 * A * ((A - 1) + (A + 1) * cosw);
+        b2 = A * ((A + 1) + (A - 1) * cosw - sqrtA2alpha);
+        a0 = (A + 1) - (A - 1) * cosw + sqrtA2alpha;
+        a1 = 2 * ((A - 1) - (A + 1) * cosw);
+        a2 = (A + 1) - (A - 1) * cosw - sqrtA2alpha;
+        break;
+
+    case FILTER_LOW_PASS:
+        b0 = (1 - cosw) / 2;
+        b1 = 1 - cosw;
+        b2 = (1 - cosw) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+
+    case FILTER_HIGH_PASS:
+        b0 = (1 + cosw) / 2;
+        b1 = -(1 + cosw);
+        b2 = (1 + cosw) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+
+    default: /* FILTER_NOTCH */
+        b0 = 1;
+        b1 = -2 * cosw;
+        b2 = 1;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+    }
+
+    coefs[0] = b0 / a0;
+    coefs[1] = b1 / a0;
+    coefs[2] = b2 / a0;
+    coefs[3] = a1 / a0;
+    coefs[4] = a2 / a0;
+}
+
+/* computes the new coefficients and starts the transition towards them */
+static void update_targets (bool immediate)
+{
+    double preamp = pow (10, preamp_db / 20);
+
+    for (int g = 0; g < MAX_GROUPS; g ++)
+    {
+        target_stages[g] = 0;
+
+        for (int s = 0; s < MAX_STAGES; s ++)
+        {
+            StageTarget & t = targets[g][s];
+
+            for (int l = 0; l < LANES; l ++)
+            {
+                int c = g * LANES + l;
+                double coefs[5] = {1, 0, 0, 0, 0}; /* pass-through */
+
+                if (c < current_channels && s < filters[c].len ())
+                {
+                    calc_coefs (filters[c][s], coefs);
+                    target_stages[g] = aud::max (target_stages[g], s + 1);
+                }
+
+                t.b0[l] = coefs[0];
+                t.b1[l] = coefs[1];
+                t.b2[l] = coefs[2];
+                t.a1[l] = coefs[3];
+                t.a2[l] = coefs[4];
+            }
+        }
+
+        for (int l = 0; l < LANES; l ++)
+            gain_target[g][l] = preamp;
+
+        /* stages that are going away keep running until the end of the
+         * transition, while they fade to pass-through */
+        if (! immediate)
+            active_stages[g] = aud::max (active_stages[g], target_stages[g]);
+    }
+
+    if (immediate)
+    {
+        for (int g = 0; g < MAX_GROUPS; g ++)
+        {
+            for (int s = 0; s < MAX_STAGES; s ++)
+            {
+                Stage & st = stages[g][s];
+                const StageTarget & t = targets[g][s];
+
+                st.b0 = t.b0;
+                st.b1 = t.b1;
+                st.b2 = t.b2;
+                st.a1 = t.a1;
+                st.a2 = t.a2;
+            }
+
+            gain[g] = gain_target[g];
+            active_stages[g] = target_stages[g];
+        }
+
+        ramp_left = 0;
+    }
+    else
+        ramp_left = aud::max (1, aud::rescale (current_rate, 1000, RAMP_TIME) / STEP_FRAMES);
+
+    step_pos = 0;
+}
+
+/* moves the coefficients one step closer to their targets */
+static void ramp_step ()
+{
+    double frac = 1.0 / ramp_left;
+
+    for (int g = 0; g < MAX_GROUPS; g ++)
+    {
+        for (int s = 0; s < active_stages[g]; s ++)
+        {
+            Stage & st = stages[g][s];
+            const StageTarget & t = targets[g][s];
+
+            st.b0 += (t.b0 - st.b0) * frac;
+            st.b1 += (t.b1 - st.b1) * frac;
+            st.b2 += (t.b2 - st.b2) * frac;
+            st.a1 += (t.a1 - st.a1) * frac;
+            st.a2 += (t.a2 - st.a2) * frac;
+        }
+
+        gain[g] += (gain_target[g] - gain[g]) * frac;
+    }
+
+    if (! -- ramp_left)
+    {
+        for (int g = 0; g < MAX_GROUPS; g ++)
+        {
+            /* the stages beyond the target are now pass-through */
+            for (int s = target_stages[g]; s < active_stages[g]; s ++)
+                stages[g][s].z1 = stages[g][s].z2 = Vector {};
+
+            active_stages[g] = target_stages[g];
+        }
+    }
+}
+
+static void reset_state ()
+{
+    for (auto & group : stages)
+    {
+        for (Stage & st : group)
+            st.z1 = st.z2 = Vector {};
+    }
+}
+
+static void run_group (int g, float * data, int frames)
+{
+    Stage * group = stages[g];
+    int n_stages = active_stages[g];
+    Vector group_gain = gain[g];
+
+    int first = g * LANES;
+    int lanes = aud::min (LANES, current_channels - first);
+
+    for (int f = 0; f < frames; f ++)
+    {
+        float * frame = data + f * current_channels + first;
+        Vector x {};
+
+        for (int l = 0; l < lanes; l ++)
+            x[l] = frame[l];
+
+        x *= group_gain;
+
+        for (int s = 0; s < n_stages; s ++)
+        {
+            Stage & st = group[s];
+            Vector y = st.b0 * x + st.z1;
+
+            st.z1 = st.b1 * x - st.a1 * y + st.z2;
+            st.z2 = st.b2 * x - st.a2 * y;
+            x = y;
+        }
+
+        for (int l = 0; l < lanes; l ++)
+            frame[l] = x[l];
+    }
+}
+
+bool ParametricEQ::init ()
+{
+    aud_config_set_defaults ("parametric-eq", eq_defaults);
+    filters_changed ();
+    return true;
+}
+
+void ParametricEQ::cleanup ()
+{
+    auto lh = filters_lock.take ();
+
+    for (int c = 0; c < AUD_MAX_CHANNELS; c ++)
+    {
+        filters[c].clear ();
+        new_filters[c].clear ();
+    }
+
+    preamp_db = 0;
+    filters_dirty = false;
+}
+
+void ParametricEQ::start (int & channels, int & rate)
+{
+    current_channels = channels;
+    current_rate = rate;
+
+    take_filters ();
+    update_targets (true);
+    reset_state ();
+}
+
+Index<float> & ParametricEQ::process (Index<float> & data)
+{
+    if (take_filters ())
+        update_targets (false);
+
+    int groups = (current_channels + LANES - 1) / LANES;
+    float * f = data.begin ();
+    int frames = data.len () / current_channels;
+
+    while (frames > 0)
+    {
+        int chunk = frames;
+
+        /* stop at the next coefficient update */
+        if (ramp_left)
+            chunk = aud::min (chunk, STEP_FRAMES - step_pos);
+
+        for (int g = 0; g < groups; g ++)
+            run_group (g, f, chunk);
+
+        if (ramp_left && (step_pos += chunk) == STEP_FRAMES)
+        {
+            ramp_step ();
+            step_pos = 0;
+        }
+
+        f += chunk * current_channels;
+        frames -= chunk;
+    }
+
+    return data;
+}
+
+bool ParametricEQ::flush (bool force)
+{
+    reset_state ();
+    return true;
+}
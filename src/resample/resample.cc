@@ -17,18 +17,25 @@
  * the use of this software.
  */
 
+#include <math.h>
 #include <samplerate.h>
 
+#include <numeric>
+
 #include <libaudcore/i18n.h>
 #include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 #include <libaudcore/audstrings.h>
 
+#include "../effect-common/profiler.h"
+
 #define MIN_RATE 8000
 #define MAX_RATE 192000
 #define RATE_STEP 50
 
+#define MAX_PHASES 320
+
 #define RESAMPLE_ERROR(e) AUDERR ("%s\n", src_strerror (e))
 
 class Resampler : public EffectPlugin
@@ -58,13 +65,13 @@ public:
     Index<float> & process (Index<float> & data) override
         { return resample (data, false); }
     Index<float> & finish (Index<float> & data, bool end_of_playlist) override
-        { return resample (data, true); }
+        { return resample (data, end_of_playlist); }
 
 private:
     Index<float> & resample (Index<float> & data, bool finish);
 };
 
-EXPORT Resampler aud_plugin_instance;
+EXPORT PROFILED (Resampler) aud_plugin_instance;
 
 const char * const Resampler::defaults[] = {
  "method", aud::numeric_string<SRC_SINC_FASTEST>::str,
@@ -83,17 +90,35 @@ const char * const Resampler::defaults[] = {
  nullptr};
 
 static SRC_STATE * state;
-static int stored_channels;
+static int stored_channels, stored_rate, stored_new_rate, stored_method;
 static double ratio;
 static Index<float> buffer;
 
+/* The converter keeps running across songs in the same format, so at the end
+ * of a song the last few milliseconds are still held in its filter.  When the
+ * next song needs a different converter, that tail is drained in start () and
+ * output ahead of the next song. */
+static bool has_input;         /* the filter holds input not yet drained */
+static Index<float> pending;   /* tail of the previous song */
+
+/* Polyphase filter, used with the sinc methods when the ratio of the rates is
+ * a fraction with a small numerator (such as 160/147 for 44.1 to 48 kHz).  The
+ * input is conceptually upsampled by <poly_up>, lowpass filtered, and then
+ * downsampled by <poly_down>; only the filter phases that are actually needed
+ * are computed. */
+static bool poly_active;
+static int poly_up, poly_down, poly_taps;
+static Index<float> poly_coefs;  /* [phase][tap], taps in reverse order */
+static Index<float> poly_in;     /* interleaved, with history at the start */
+static int poly_pos, poly_phase; /* input frame and filter phase of the next output */
+
 bool Resampler::init ()
 {
     aud_config_set_defaults ("resample", defaults);
     return true;
 }
 
-void Resampler::cleanup ()
+static void free_state ()
 {
     if (state)
     {
@@ -101,17 +126,144 @@ void Resampler::cleanup ()
         state = nullptr;
     }
 
+    has_input = false;
+    poly_active = false;
+    poly_coefs.clear ();
+    poly_in.clear ();
+}
+
+void Resampler::cleanup ()
+{
+    free_state ();
+    stored_rate = 0;
+    has_input = false;
     buffer.clear ();
+    pending.clear ();
 }
 
-void Resampler::start (int & channels, int & rate)
+/* zeroth-order modified Bessel function of the first kind */
+static double bessel_i0 (double x)
 {
-    if (state)
+    double sum = 1, term = 1;
+
+    for (int k = 1; k < 50 && term > sum * 1e-12; k ++)
     {
-        src_delete (state);
-        state = nullptr;
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+static bool poly_setup (int rate, int new_rate, int method)
+{
+    int taps;
+    double atten; /* stopband attenuation, dB */
+
+    switch (method)
+    {
+    case SRC_SINC_FASTEST:
+        taps = 64;
+        atten = 90;
+        break;
+    case SRC_SINC_MEDIUM_QUALITY:
+        taps = 128;
+        atten = 100;
+        break;
+    case SRC_SINC_BEST_QUALITY:
+        taps = 256;
+        atten = 120;
+        break;
+    default:
+        return false;
+    }
+
+    int gcd = std::gcd (rate, new_rate);
+    int up = new_rate / gcd;
+    int down = rate / gcd;
+
+    if (up > MAX_PHASES)
+        return false;
+
+    /* when downsampling, the filter is stretched to the lower cutoff */
+    double scale = aud::min (1.0, (double) up / down);
+    taps = (int) ceil (taps / scale);
+
+    /* Kaiser window design: transition band and cutoff in units of the input
+     * sample rate, placing the stopband edge at the lower Nyquist frequency */
+    double width = (atten - 8) / (2.285 * 2 * M_PI * taps);
+    double cutoff = 0.5 * scale - width / 2;
+    double beta = (atten > 50) ? 0.1102 * (atten - 8.7) : 0.5842 * pow (atten - 21, 0.4) + 0.07886 * (atten - 21);
+
+    int length = taps * up;
+    double center = length / 2;
+
+    poly_coefs.resize (length);
+
+    for (int phase = 0; phase < up; phase ++)
+    {
+        for (int k = 0; k < taps; k ++)
+        {
+            double t = (phase + k * up - center) / up;  /* in input samples */
+            double x = 2 * cutoff * t;
+            double sinc = (x == 0) ? 1 : sin (M_PI * x) / (M_PI * x);
+            double w = (phase + k * up - center) / center;
+            double window = (fabs (w) < 1) ? bessel_i0 (beta * sqrt (1 - w * w)) / bessel_i0 (beta) : 0;
+
+            poly_coefs[phase * taps + (taps - 1 - k)] = 2 * cutoff * sinc * window;
+        }
+    }
+
+    poly_up = up;
+    poly_down = down;
+    poly_taps = taps;
+    poly_active = true;
+
+    return true;
+}
+
+static void poly_reset ()
+{
+    /* start with a history of silence, positioned so that the output is in
+     * time with the input despite the delay of the filter */
+    int delay = poly_taps * poly_up / 2;
+
+    poly_in.resize (0);
+    poly_in.insert (0, (poly_taps - 1) * stored_channels);
+
+    poly_pos = poly_taps - 1 + delay / poly_up;
+    poly_phase = delay % poly_up;
+}
+
+static bool create_state (int channels, int rate, int new_rate, int method)
+{
+    stored_channels = channels;
+    stored_rate = rate;
+    stored_new_rate = new_rate;
+    stored_method = method;
+    ratio = (double) new_rate / rate;
+
+    if (poly_setup (rate, new_rate, method))
+    {
+        poly_reset ();
+        return true;
     }
 
+    int error;
+    if ((state = src_new (method, channels, & error)) == nullptr)
+    {
+        RESAMPLE_ERROR (error);
+        stored_rate = 0;
+        return false;
+    }
+
+    return true;
+}
+
+static Index<float> & convert (Index<float> & data, bool finish);
+
+void Resampler::start (int & channels, int & rate)
+{
     int new_rate = 0;
 
     if (aud_get_bool ("resample", "use-mappings"))
@@ -122,60 +274,184 @@ void Resampler::start (int & channels, int & rate)
 
     new_rate = aud::clamp (new_rate, MIN_RATE, MAX_RATE);
 
-    if (new_rate == rate)
-        return;
-
     int method = aud_get_int ("resample", "method");
-    int error;
 
-    if ((state = src_new (method, channels, & error)) == nullptr)
+    /* keep the converter running across songs in the same format, which
+     * avoids rebuilding it (and a discontinuity) at each song change */
+    if ((state || poly_active) && channels == stored_channels &&
+     rate == stored_rate && new_rate == stored_new_rate && method == stored_method)
     {
-        RESAMPLE_ERROR (error);
+        rate = new_rate;
         return;
     }
 
-    stored_channels = channels;
-    ratio = (double) new_rate / rate;
-    rate = new_rate;
+    int tail_channels = stored_channels;
+    int tail_rate = stored_new_rate;
+
+    pending.resize (0);
+
+    if (has_input)
+    {
+        Index<float> empty;
+        Index<float> & tail = convert (empty, true);
+        pending.insert (tail.begin (), 0, tail.len ());
+    }
+
+    free_state ();
+    stored_rate = 0;
+
+    if (new_rate != rate && create_state (channels, rate, new_rate, method))
+        rate = new_rate;
+
+    /* the tail can only be output if the output format stays the same */
+    if (channels != tail_channels || rate != tail_rate)
+        pending.resize (0);
 }
 
-Index<float> & Resampler::resample (Index<float> & data, bool finish)
+static void poly_process (Index<float> & data, bool finish)
+{
+    int chans = stored_channels;
+
+    poly_in.insert (data.begin (), -1, data.len ());
+
+    /* at the end of the playlist, add enough silence to flush the filter */
+    if (finish)
+        poly_in.insert (-1, poly_taps / 2 * chans);
+
+    int in_frames = poly_in.len () / chans;
+    int max_out = (int64_t) (in_frames - poly_pos) * poly_up / poly_down + 1;
+
+    buffer.resize (aud::max (0, max_out) * chans);
+
+    float * out = buffer.begin ();
+    int out_frames = 0;
+
+    while (poly_pos < in_frames)
+    {
+        const float * h = & poly_coefs[poly_phase * poly_taps];
+        const float * x = & poly_in[(poly_pos - poly_taps + 1) * chans];
+
+        for (int c = 0; c < chans; c ++)
+        {
+            float sum = 0;
+            for (int k = 0; k < poly_taps; k ++)
+                sum += h[k] * x[k * chans + c];
+
+            out[c] = sum;
+        }
+
+        out += chans;
+        out_frames ++;
+
+        poly_phase += poly_down;
+        poly_pos += poly_phase / poly_up;
+        poly_phase %= poly_up;
+    }
+
+    buffer.resize (out_frames * chans);
+
+    /* keep the history needed for the next output */
+    int discard = aud::min (poly_pos - (poly_taps - 1), in_frames);
+    if (discard > 0)
+    {
+        poly_in.remove (0, discard * chans);
+        poly_pos -= discard;
+    }
+}
+
+static void reset_state ()
 {
-    if (! state || ! data.len ())
+    int error;
+    if (state && (error = src_reset (state)))
+        RESAMPLE_ERROR (error);
+
+    if (poly_active)
+        poly_reset ();
+
+    has_input = false;
+}
+
+static Index<float> & convert (Index<float> & data, bool finish)
+{
+    if (poly_active)
+    {
+        has_input = true;
+        poly_process (data, finish);
+
+        if (finish)
+            reset_state ();
+
+        return buffer;
+    }
+
+    if (! state || (! data.len () && ! finish))
         return data;
 
-    buffer.resize ((int) (data.len () * ratio) + 256);
+    has_input = true;
+
+    /* the buffer keeps its allocation when shrunk, so this does not allocate
+     * once it has reached its largest size */
+    buffer.resize ((int) (data.len () * ratio) + 256 * stored_channels);
 
     SRC_DATA d = SRC_DATA ();
 
     d.data_in = data.begin ();
     d.input_frames = data.len () / stored_channels;
-    d.data_out = buffer.begin ();
-    d.output_frames = buffer.len () / stored_channels;
     d.src_ratio = ratio;
     d.end_of_input = finish;
 
-    int error;
-    if ((error = src_process (state, & d)))
+    int out_frames = 0;
+
+    while (1)
     {
-        RESAMPLE_ERROR (error);
-        return data;
+        d.data_out = buffer.begin () + out_frames * stored_channels;
+        d.output_frames = buffer.len () / stored_channels - out_frames;
+
+        int error;
+        if ((error = src_process (state, & d)))
+        {
+            RESAMPLE_ERROR (error);
+            return data;
+        }
+
+        out_frames += d.output_frames_gen;
+        d.data_in += d.input_frames_used * stored_channels;
+        d.input_frames -= d.input_frames_used;
+
+        /* stop once the output fits, which at the end means that the filter
+         * has been drained completely */
+        if (d.output_frames_gen < d.output_frames)
+            break;
+
+        buffer.resize (buffer.len () + 256 * stored_channels);
     }
 
-    buffer.resize (stored_channels * d.output_frames_gen);
+    buffer.resize (stored_channels * out_frames);
 
     if (finish)
-        flush (true);
+        reset_state ();
 
     return buffer;
 }
 
-bool Resampler::flush (bool force)
+Index<float> & Resampler::resample (Index<float> & data, bool finish)
 {
-    int error;
-    if (state && (error = src_reset (state)))
-        RESAMPLE_ERROR (error);
+    Index<float> & out = convert (data, finish);
 
+    /* the end of the previous song goes first */
+    if (pending.len ())
+    {
+        out.insert (pending.begin (), 0, pending.len ());
+        pending.resize (0);
+    }
+
+    return out;
+}
+
+bool Resampler::flush (bool force)
+{
+    reset_state ();
+    pending.resize (0);
     return true;
 }
 
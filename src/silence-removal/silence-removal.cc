@@ -17,6 +17,8 @@
  * the use of this software.
  */
 
+#include <atomic>
+
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
@@ -25,6 +27,9 @@
 
 #include <math.h>
 
+#include "../effect-common/dsp.h"
+#include "../effect-common/profiler.h"
+
 #define MAX_BUFFER_SECS  10
 
 class SilenceRemoval : public EffectPlugin
@@ -52,7 +57,7 @@ public:
     bool flush (bool force) override;
 };
 
-EXPORT SilenceRemoval aud_plugin_instance;
+EXPORT PROFILED (SilenceRemoval) aud_plugin_instance;
 
 const char SilenceRemoval::about[] =
  N_("Silence Removal Plugin for Audacious\n"
@@ -60,23 +65,54 @@ const char SilenceRemoval::about[] =
 
 const char * const SilenceRemoval::defaults[] = {
     "threshold", "-40",
+    "rms_detection", "FALSE",
+    "rms_window", "50",
     nullptr
 };
 
+static std::atomic<bool> settings_dirty (true);
+
+static void settings_changed ()
+{
+    settings_dirty = true;
+}
+
 const PreferencesWidget SilenceRemoval::widgets[] = {
     WidgetLabel (N_("<b>Silence Removal</b>")),
     WidgetSpin (N_("Threshold:"),
-        WidgetInt ("silence-removal", "threshold"),
-        {-60, -20, 1, N_("dB")})
+        WidgetInt ("silence-removal", "threshold", settings_changed),
+        {-60, -20, 1, N_("dB")}),
+    WidgetCheck (N_("Treat quiet noise as silence (RMS detection)"),
+        WidgetBool ("silence-removal", "rms_detection", settings_changed)),
+    WidgetSpin (N_("Window:"),
+        WidgetInt ("silence-removal", "rms_window", settings_changed),
+        {5, 500, 5, N_("ms")},
+        WIDGET_CHILD)
 };
 
 const PluginPreferences SilenceRemoval::prefs = {{widgets}};
 
 static RingBuf<float> buffer;
 static Index<float> output;
-static int current_channels;
+static int current_channels, current_rate;
 static bool initial_silence;
 
+static float threshold;
+static int rms_window;  /* in samples, or 0 to detect peaks */
+
+static void update_settings ()
+{
+    threshold = powf (10.0f, aud_get_int ("silence-removal", "threshold") / 20.0f);
+
+    if (aud_get_bool ("silence-removal", "rms_detection"))
+    {
+        int ms = aud::clamp (aud_get_int ("silence-removal", "rms_window"), 5, 500);
+        rms_window = aud::max (1, aud::rescale (ms, 1000, current_rate)) * current_channels;
+    }
+    else
+        rms_window = 0;
+}
+
 bool SilenceRemoval::init ()
 {
     aud_config_set_defaults ("silence-removal", defaults);
@@ -96,7 +132,11 @@ void SilenceRemoval::start (int & channels, int & rate)
     output.resize (0);
 
     current_channels = channels;
+    current_rate = rate;
     initial_silence = true;
+
+    settings_dirty = false;
+    update_settings ();
 }
 
 static float * align_to_frame (float * begin, float * sample, bool align_to_end)
@@ -111,6 +151,68 @@ static float * align_to_frame (float * begin, float * sample, bool align_to_end)
     return begin + (offset - offset % current_channels);
 }
 
+static bool window_is_loud (const float * data, int len)
+{
+    float sum = 0;
+    for (int i = 0; i < len; i ++)
+        sum += data[i] * data[i];
+
+    return sum > threshold * threshold * len;
+}
+
+/* Finds the first and last sample above the threshold.  In RMS mode, the data
+ * is divided into windows, and only samples in windows whose RMS level is above
+ * the threshold are considered.  Since the RMS level of a window never exceeds
+ * its peak, such a window always contains at least one sample above the
+ * threshold.  Both searches stop as soon as a match is found. */
+static void find_signal (float * data, int len, float * & first, float * & last)
+{
+    first = last = nullptr;
+
+    if (! rms_window)
+    {
+        int i = dsp_find_first_above (data, len, threshold);
+        if (i < 0)
+            return;
+
+        first = data + i;
+        last = data + i + dsp_find_last_above (data + i, len - i, threshold);
+        return;
+    }
+
+    int end = len;
+    for (int start = 0; start < end; start += rms_window)
+    {
+        int window = aud::min (rms_window, end - start);
+        int i;
+        if (window_is_loud (data + start, window) &&
+         (i = dsp_find_first_above (data + start, window, threshold)) >= 0)
+        {
+            first = data + start + i;
+            break;
+        }
+    }
+
+    if (! first)
+        return;
+
+    /* windows are counted from the start of the data, so the last one may be
+     * partial; search backward only as far as the window containing <first>,
+     * which is known to contain a sample above the threshold */
+    int limit = (first - data) - (first - data) % rms_window;
+    for (int start = (len - 1) - (len - 1) % rms_window; start >= limit; start -= rms_window)
+    {
+        int window = aud::min (rms_window, len - start);
+        int i;
+        if ((start == limit || window_is_loud (data + start, window)) &&
+         (i = dsp_find_last_above (data + start, window, threshold)) >= 0)
+        {
+            last = data + start + i;
+            break;
+        }
+    }
+}
+
 static void buffer_with_overflow (const float * data, int len)
 {
     int max = buffer.size ();
@@ -133,22 +235,11 @@ static void buffer_with_overflow (const float * data, int len)
 
 Index<float> & SilenceRemoval::process (Index<float> & data)
 {
-    const int threshold_db = aud_get_int ("silence-removal", "threshold");
-    const float threshold = powf (10.0f, threshold_db / 20.0f);
+    if (settings_dirty.exchange (false))
+        update_settings ();
 
-    float * first_sample = nullptr;
-    float * last_sample = nullptr;
-
-    for (float & sample : data)
-    {
-        if (sample > threshold || sample < -threshold)
-        {
-            if (! first_sample)
-                first_sample = & sample;
-
-            last_sample = & sample;
-        }
-    }
+    float * first_sample, * last_sample;
+    find_signal (data.begin (), data.len (), first_sample, last_sample);
 
     first_sample = align_to_frame (data.begin (), first_sample, false);
     last_sample = align_to_frame (data.begin (), last_sample, true);
@@ -163,6 +254,10 @@ Index<float> & SilenceRemoval::process (Index<float> & data)
 
         initial_silence = false;
 
+        /* common case: nothing saved and nothing to trim, pass the data on */
+        if (! buffer.len () && first_sample == data.begin () && last_sample == data.end ())
+            return data;
+
         /* copy any saved silence from previous call */
         buffer.move_out (output, -1, -1);
 
@@ -28,10 +28,15 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/profiler.h"
+
 #define MIN_RATE 8000
 #define MAX_RATE 192000
 #define RATE_STEP 50
 
+/* converters kept around for reuse; each holds a complete filter design */
+#define MAX_SETUPS 4
+
 class SoXResampler : public EffectPlugin
 {
 public:
@@ -58,7 +63,7 @@ public:
     bool flush (bool force) override;
 };
 
-EXPORT SoXResampler aud_plugin_instance;
+EXPORT PROFILED (SoXResampler) aud_plugin_instance;
 
 const char * const SoXResampler::defaults[] = {
     "quality", aud::numeric_string<SOXR_HQ>::str,
@@ -71,11 +76,19 @@ const char * const SoXResampler::defaults[] = {
     nullptr
 };
 
+struct SoxrSetup
+{
+    soxr_t soxr;
+    int rate, target_rate, channels;
+    unsigned long recipe;
+    unsigned last_used;
+};
+
+static SoxrSetup setups[MAX_SETUPS];
+static unsigned use_count;
+
 static soxr_t soxr;
 static soxr_error_t error;
-static soxr_quality_spec_t q;
-static int stored_rate;
-static int target_rate;
 static int stored_channels;
 static double ratio;
 static Index<float> buffer;
@@ -88,40 +101,79 @@ bool SoXResampler::init ()
 
 void SoXResampler::cleanup ()
 {
-    soxr_delete (soxr);
+    for (SoxrSetup & setup : setups)
+    {
+        soxr_delete (setup.soxr);
+        setup = SoxrSetup ();
+    }
+
     soxr = 0;
     buffer.clear ();
 }
 
-void SoXResampler::start (int & channels, int & rate)
+/* Returns a converter for the given parameters, reusing a cached one (reset
+ * for a fresh signal) if possible.  Otherwise, the least recently used one is
+ * replaced by a new converter, which is where the filter design happens. */
+static soxr_t get_soxr (int rate, int target_rate, int channels, unsigned long recipe)
 {
-    soxr_delete (soxr);
-    soxr = 0;
+    SoxrSetup * oldest = & setups[0];
 
-    target_rate = aud_get_int ("soxr", "rate");
+    for (SoxrSetup & setup : setups)
+    {
+        if (setup.soxr && setup.rate == rate && setup.target_rate == target_rate &&
+         setup.channels == channels && setup.recipe == recipe)
+        {
+            setup.last_used = ++ use_count;
+
+            if (setup.soxr != soxr && (error = soxr_clear (setup.soxr)))
+                AUDERR ("%s\n", error);
+
+            return setup.soxr;
+        }
+
+        if (! setup.soxr || (oldest->soxr && setup.last_used < oldest->last_used))
+            oldest = & setup;
+    }
+
+    soxr_delete (oldest->soxr);
+    * oldest = SoxrSetup ();
+
+    soxr_quality_spec_t q = soxr_quality_spec (recipe, 0);
+    soxr_t created = soxr_create (rate, target_rate, channels, & error, nullptr, & q, nullptr);
+
+    if (error)
+    {
+        AUDERR ("%s\n", error);
+        soxr_delete (created);
+        return 0;
+    }
+
+    * oldest = {created, rate, target_rate, channels, recipe, ++ use_count};
+    return created;
+}
+
+void SoXResampler::start (int & channels, int & rate)
+{
+    int target_rate = aud_get_int ("soxr", "rate");
     target_rate = aud::clamp (target_rate, MIN_RATE, MAX_RATE);
 
     if (target_rate == rate)
+    {
+        soxr = 0;
         return;
+    }
 
-    stored_rate = rate;
-
-    int recipe = aud_get_int ("soxr", "quality");
+    unsigned long recipe = aud_get_int ("soxr", "quality");
     recipe |= aud_get_int ("soxr", "phase_response");
     recipe |= (aud_get_bool ("soxr", "use_steep_filter")) ? SOXR_STEEP_FILTER : 0;
 #ifdef SOXR_ALLOW_ALIASING
     recipe |= (aud_get_bool ("soxr", "allow_aliasing")) ? SOXR_ALLOW_ALIASING : 0;
 #endif
 
-    q = soxr_quality_spec (recipe, 0);
-
-    soxr = soxr_create (rate, target_rate, channels, & error, nullptr, & q, nullptr);
-
-    if (error)
-    {
-        AUDERR ("%s\n", error);
+    /* if the converter in use already matches, it keeps running across songs
+     * in the same format, which also avoids a discontinuity at each change */
+    if (! (soxr = get_soxr (rate, target_rate, channels, recipe)))
         return;
-    }
 
     stored_channels = channels;
     ratio = (double) target_rate / rate;
@@ -133,7 +185,11 @@ Index<float> & SoXResampler::process (Index<float> & data)
     if (! soxr)
          return data;
 
-    buffer.resize ((int) (data.len () * ratio) + 256);
+    /* the buffer keeps its allocation when it is shrunk below, so it only
+     * needs to grow by the few frames that the output can vary by */
+    int needed = (int) (data.len () * ratio) + 256 * stored_channels;
+    if (buffer.len () < needed)
+        buffer.resize (needed);
 
     size_t samples_done;
     error = soxr_process (soxr, data.begin (), data.len () / stored_channels,
@@ -155,15 +211,9 @@ bool SoXResampler::flush (bool force)
     if (! soxr)
         return true;
 
-    soxr_delete (soxr);
-
-    soxr = soxr_create (stored_rate, target_rate, stored_channels, & error, nullptr, & q, nullptr);
-
-    if (error)
-    {
+    /* discard the buffered signal but keep the filter */
+    if ((error = soxr_clear (soxr)))
         AUDERR ("%s\n", error);
-        return true;
-    }
 
     return true;
 }
@@ -26,15 +26,35 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/fft.h"
+#include "../effect-common/profiler.h"
+
 /* The general idea of the speed change algorithm is to divide the input signal
  * into pieces, spaced at a time interval A, using a cosine-shaped window
  * function.  The pieces are then reassembled by adding them together again,
  * spaced at another time interval B.  By varying the ratio A:B, we change the
- * speed of the audio. */
+ * speed of the audio.
+ *
+ * In WSOLA mode (waveform similarity overlap-add), each piece is not taken
+ * exactly at its nominal position but anywhere within SEARCH_MS of it, at the
+ * point where its waveform best matches the natural continuation of the
+ * previous piece.  This keeps the pieces in phase and avoids the warbling of
+ * the simple method.  The search is a cross-correlation of a downmixed and
+ * decimated copy of the audio, computed with an FFT, followed by a refinement
+ * at the full sample rate. */
 
 #define FREQ    10
 #define OVERLAP  3
 
+#define WINDOW_MS 30
+#define SEARCH_MS 10
+#define SEARCH_RATE 16000 /* approximate sample rate of the coarse search */
+
+enum {
+    MODE_OLA,
+    MODE_WSOLA
+};
+
 #define CFGSECT "speed-pitch"
 #define MINSPEED 0.25
 #define MAXSPEED 2.0
@@ -75,7 +95,7 @@ private:
     Index<float> & process (Index<float> & samples, bool ending);
 };
 
-EXPORT SpeedPitch aud_plugin_instance;
+EXPORT PROFILED (SpeedPitch) aud_plugin_instance;
 
 static double semitones;
 static int curchans, currate;
@@ -85,8 +105,30 @@ static Index<float> cosine;
 static Index<float> in, out;
 static int src, dst;
 
+/* WSOLA state, in frames */
+static int wsola_mode;
+static bool decoupled;  /* otherwise the input is passed through */
+static int wsola_width, wsola_step, wsola_search, wsola_decimate;
+static Index<float> wsola_window;
+static double wsola_src;    /* nominal position of the next piece in <in> */
+static int wsola_prev;      /* actual position of the last piece in <in> */
+static int wsola_skip;      /* output frames still to be discarded */
+
+/* scratch space for the search, allocated in start() */
+static RealFFT corr_fft;
+static Index<float> corr_ref, corr_area, corr_result;
+static Index<RealFFT::Complex> corr_ref_freq, corr_area_freq;
+static Index<double> corr_energy;
+
 static void add_data (Index<float> & b, Index<float> & data, float ratio)
 {
+    /* no resampling needed (speed change only) */
+    if (ratio == 1)
+    {
+        b.insert (data.begin (), -1, data.len ());
+        return;
+    }
+
     int oldlen = b.len ();
     int inframes = data.len () / curchans;
     int maxframes = (int) (inframes * ratio) + 256;
@@ -119,9 +161,50 @@ bool SpeedPitch::flush (bool force)
      * the width of a cosine window. */
     out.insert (0, width / 2);
 
+    /* WSOLA starts with half a window of silence, so that the first piece
+     * fades in over silence only.  The corresponding output is discarded.
+     * Without decoupling, the input is returned as is, so no silence may be
+     * added to it. */
+    if (wsola_mode == MODE_WSOLA && decoupled)
+    {
+        out.resize (0);
+        in.insert (0, wsola_step * curchans);
+        wsola_src = 0;
+        wsola_prev = -1;
+        wsola_skip = wsola_step;
+    }
+
     return true;
 }
 
+static void wsola_start ()
+{
+    wsola_step = aud::rescale (currate, 1000, WINDOW_MS) / 2;
+    wsola_width = wsola_step * 2;
+    wsola_search = aud::rescale (currate, 1000, SEARCH_MS);
+    wsola_decimate = aud::max (1, currate / SEARCH_RATE);
+
+    /* periodic Hann window, which sums to one at 50% overlap */
+    wsola_window.resize (wsola_width);
+    for (int i = 0; i < wsola_width; i ++)
+        wsola_window[i] = 0.5 - 0.5 * cos (2.0 * M_PI * i / wsola_width);
+
+    int ref_len = wsola_step / wsola_decimate;
+    int area_len = ref_len + 2 * wsola_search / wsola_decimate + 1;
+
+    int fft_size = 4;
+    while (fft_size < area_len)
+        fft_size *= 2;
+
+    corr_fft.init (fft_size);
+    corr_ref.resize (fft_size);
+    corr_area.resize (fft_size);
+    corr_result.resize (fft_size);
+    corr_ref_freq.resize (fft_size / 2 + 1);
+    corr_area_freq.resize (fft_size / 2 + 1);
+    corr_energy.resize (area_len + 1);
+}
+
 void SpeedPitch::start (int & chans, int & rate)
 {
     curchans = chans;
@@ -132,6 +215,10 @@ void SpeedPitch::start (int & chans, int & rate)
 
     srcstate = src_new (SRC_LINEAR, curchans, nullptr);
 
+    wsola_mode = aud_get_int (CFGSECT, "mode");
+    decoupled = aud_get_bool (CFGSECT, "decouple");
+    wsola_start ();
+
     /* Calculate the width of the cosine window and the spacing interval for
      * output.  Make them both even numbers for convenience.  Note that the
      * cosine window is applied without deinterleaving the audio samples. */
@@ -147,21 +234,225 @@ void SpeedPitch::start (int & chans, int & rate)
     flush (true);
 }
 
+/* mixes <len> frames of <b> starting at frame <pos> down to mono, summing
+ * each group of <decimate> frames; frames outside of <b> count as silence */
+static void downmix (const Index<float> & b, int pos, int len, int decimate, float * mono)
+{
+    int frames = b.len () / curchans;
+
+    for (int i = 0; i < len; i ++)
+    {
+        float sum = 0;
+
+        for (int f = pos + i * decimate; f < pos + (i + 1) * decimate; f ++)
+        {
+            if (f < 0 || f >= frames)
+                continue;
+
+            for (int c = 0; c < curchans; c ++)
+                sum += b[f * curchans + c];
+        }
+
+        mono[i] = sum;
+    }
+}
+
+/* similarity of the half windows starting at frames <a> and <b> of the input,
+ * which is the part where consecutive pieces overlap */
+static double similarity (int a, int b)
+{
+    int frames = in.len () / curchans;
+    int len = aud::min (wsola_step, frames - aud::max (a, b));
+    double dot = 0, energy = 0;
+
+    for (int i = 0; i < len * curchans; i += curchans)
+    {
+        float x = 0, y = 0;
+
+        for (int c = 0; c < curchans; c ++)
+        {
+            x += in[a * curchans + i + c];
+            y += in[b * curchans + i + c];
+        }
+
+        dot += x * y;
+        energy += y * y;
+    }
+
+    return dot / sqrt (energy + 1e-9);
+}
+
+/* Returns the frame between <lo> and <hi> (inclusive) where the piece best
+ * matches the one starting at frame <ref>. */
+static int find_splice (int ref, int lo, int hi)
+{
+    int dec = wsola_decimate;
+    int ref_len = wsola_step / dec;
+    int shifts = (hi - lo) / dec + 1;
+    int area_len = ref_len + shifts - 1;
+
+    /* cross-correlation of the decimated pieces via FFT */
+    corr_ref.erase (0, -1);
+    corr_area.erase (0, -1);
+    downmix (in, ref, ref_len, dec, corr_ref.begin ());
+    downmix (in, lo, area_len, dec, corr_area.begin ());
+
+    corr_fft.forward (corr_ref.begin (), corr_ref_freq.begin ());
+    corr_fft.forward (corr_area.begin (), corr_area_freq.begin ());
+
+    for (int k = 0; k < corr_ref_freq.len (); k ++)
+        corr_area_freq[k] *= std::conj (corr_ref_freq[k]);
+
+    corr_fft.inverse (corr_area_freq.begin (), corr_result.begin ());
+
+    /* normalize by the energy of each candidate piece */
+    corr_energy[0] = 0;
+    for (int i = 0; i < area_len; i ++)
+        corr_energy[i + 1] = corr_energy[i] + corr_area[i] * corr_area[i];
+
+    int best = 0;
+    double best_score = -HUGE_VAL;
+
+    for (int s = 0; s < shifts; s ++)
+    {
+        double energy = corr_energy[s + ref_len] - corr_energy[s];
+        double score = corr_result[s] / sqrt (energy + 1e-9);
+
+        if (score > best_score)
+        {
+            best = s;
+            best_score = score;
+        }
+    }
+
+    /* refine at the full sample rate */
+    int coarse = lo + best * dec;
+    int pos = coarse;
+
+    if (dec > 1)
+    {
+        best_score = -HUGE_VAL;
+
+        for (int p = aud::max (lo, coarse - dec + 1); p <= aud::min (hi, coarse + dec - 1); p ++)
+        {
+            double score = similarity (ref, p);
+
+            if (score > best_score)
+            {
+                pos = p;
+                best_score = score;
+            }
+        }
+    }
+
+    return pos;
+}
+
+static void process_wsola (float ratio, bool ending)
+{
+    int frames = in.len () / curchans;
+    double step_in = wsola_step * ratio;
+
+    /* When the song is ending, the input is padded with silence so that the
+     * last pieces can be placed, and processing stops at the end of the
+     * actual input. */
+    int end = frames;
+    if (ending)
+    {
+        in.insert (-1, (wsola_width + wsola_search + wsola_step) * curchans);
+        frames = in.len () / curchans;
+    }
+
+    while (! ending || wsola_src < end)
+    {
+        int nominal = (int) wsola_src;
+        int lo = aud::max (0, nominal - wsola_search);
+        int hi = nominal + wsola_search;
+        int ref = wsola_prev + wsola_step;
+
+        if (aud::max (hi, ref) + wsola_width > frames)
+            break;
+
+        int pos = (wsola_prev < 0) ? nominal : find_splice (ref, lo, hi);
+
+        /* The piece overlaps the last half window of the output buffer, which
+         * is still incomplete (or empty, for the first piece). */
+        if (! out.len ())
+            out.insert (0, wsola_step * curchans);
+
+        out.insert (-1, wsola_step * curchans);
+
+        float * dest = & out[out.len () - wsola_width * curchans];
+        const float * source = & in[pos * curchans];
+
+        for (int i = 0; i < wsola_width; i ++)
+        {
+            for (int c = 0; c < curchans; c ++)
+                dest[i * curchans + c] += source[i * curchans + c] * wsola_window[i];
+        }
+
+        wsola_prev = pos;
+        wsola_src += step_in;
+    }
+
+    /* Discard input that will not be needed for the next search.  The last
+     * piece is kept as well, since its position marks the start of WSOLA. */
+    int seek = aud::min ((int) wsola_src - wsola_search, wsola_prev);
+    seek = aud::clamp (seek, 0, ending ? end : frames);
+
+    in.remove (0, seek * curchans);
+    wsola_src -= seek;
+    wsola_prev -= seek;
+
+    if (ending)
+        in.remove (aud::max (0, end - seek) * curchans, -1);
+}
+
 Index<float> & SpeedPitch::process (Index<float> & data, bool ending)
 {
     const float * cosine_center = & cosine[width / 2];
     float pitch = aud_get_double (CFGSECT, "pitch");
     float speed = aud_get_double (CFGSECT, "speed");
 
+    /* When decoupling is turned off, the input buffered so far is still
+     * passed through below; when it is turned on, WSOLA starts over. */
+    bool decouple = aud_get_bool (CFGSECT, "decouple");
+    bool restart = (decouple && ! decoupled);
+    decoupled = decouple;
+
+    if (aud_get_int (CFGSECT, "mode") != wsola_mode || restart)
+    {
+        wsola_mode = aud_get_int (CFGSECT, "mode");
+        flush (true);
+    }
+
     /* Copy the passed audio to the input buffer, scaled to adjust pitch. */
     add_data (in, data, 1.0 / pitch);
 
-    if (! aud_get_bool (CFGSECT, "decouple"))
+    if (! decoupled)
     {
         data = std::move (in);
         return data;
     }
 
+    if (wsola_mode == MODE_WSOLA)
+    {
+        process_wsola (speed / pitch, ending);
+
+        /* The last half window of the output buffer is still incomplete (or
+         * not, if the song is ending). */
+        int ret = out.len () - (ending ? 0 : wsola_step * curchans);
+        int skip = aud::min (wsola_skip * curchans, ret);
+
+        out.remove (0, skip);
+        wsola_skip -= skip / curchans;
+        ret -= skip;
+
+        data.resize (0);
+        data.move_from (out, 0, 0, ret, true, true);
+        return data;
+    }
+
     /* Calculate the spacing interval for input. */
     int instep = (int) round ((outstep / curchans) * speed / pitch) * curchans;
 
@@ -203,13 +494,23 @@ Index<float> & SpeedPitch::process (Index<float> & data, bool ending)
 
 int SpeedPitch::adjust_delay (int delay)
 {
-    if (! aud_get_bool (CFGSECT, "decouple"))
+    if (! decoupled)
         return delay;
 
     float samples_to_ms = 1000.0 / (curchans * currate);
     float speed = aud_get_double (CFGSECT, "speed");
-    int in_samples = in.len () - src;
-    int out_samples = dst;
+    int in_samples, out_samples;
+
+    if (wsola_mode == MODE_WSOLA)
+    {
+        in_samples = in.len () - (int) wsola_src * curchans;
+        out_samples = out.len () - wsola_skip * curchans;
+    }
+    else
+    {
+        in_samples = in.len () - src;
+        out_samples = dst;
+    }
 
     return (delay + in_samples * samples_to_ms) * speed + out_samples * samples_to_ms;
 }
@@ -239,6 +540,7 @@ static void semitones_changed ()
 
 const char * const SpeedPitch::defaults[] = {
  "decouple", "TRUE",
+ "mode", "1", /* MODE_WSOLA */
  "speed", "1",
  "pitch", "1",
  nullptr};
@@ -251,6 +553,14 @@ const PreferencesWidget SpeedPitch::widgets[] = {
         WidgetFloat (CFGSECT, "speed", nullptr, "speed-pitch set speed"),
         {MINSPEED, MAXSPEED, 0.05},
         WIDGET_CHILD),
+    WidgetRadio (N_("Simple overlap-add"),
+        WidgetInt (CFGSECT, "mode"),
+        {MODE_OLA},
+        WIDGET_CHILD),
+    WidgetRadio (N_("Waveform matching (WSOLA)"),
+        WidgetInt (CFGSECT, "mode"),
+        {MODE_WSOLA},
+        WIDGET_CHILD),
     WidgetLabel (N_("<b>Pitch</b>")),
     WidgetSpin (nullptr,
         WidgetFloat (semitones, semitones_changed, "speed-pitch set semitones"),
@@ -280,4 +590,12 @@ void SpeedPitch::cleanup ()
     cosine.clear ();
     in.clear ();
     out.clear ();
+
+    wsola_window.clear ();
+    corr_ref.clear ();
+    corr_area.clear ();
+    corr_result.clear ();
+    corr_ref_freq.clear ();
+    corr_area_freq.clear ();
+    corr_energy.clear ();
 }
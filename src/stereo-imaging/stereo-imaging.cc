@@ -0,0 +1,280 @@
+/*
+ * Stereo Imaging Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+/* Combines the Extra Stereo, Voice Removal and BS2B effects in a single pass.
+ * Widening and voice removal are both linear in the mid and side signals, so
+ * they reduce to one 2x2 matrix applied to each frame.  The crossfeed is the
+ * same filter as in libbs2b (a low-pass for the opposite channel and a
+ * high-boost for the same channel), with the left and right channels handled
+ * together as one vector. */
+
+#include <math.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#ifdef HAVE_BS2B
+#include <bs2b.h>
+#endif
+
+#include <libaudcore/hook.h>
+#include <libaudcore/i18n.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/runtime.h>
+
+#include "../effect-common/profiler.h"
+
+/* crossfeed levels, packed as in libbs2b (cut frequency | feed level << 16) */
+#ifdef HAVE_BS2B
+#define DEFAULT_CLEVEL BS2B_DEFAULT_CLEVEL
+#define CMOY_CLEVEL BS2B_CMOY_CLEVEL
+#define JMEIER_CLEVEL BS2B_JMEIER_CLEVEL
+#else
+#define CLEVEL(fcut, feed) ((uint32_t) (fcut) | ((uint32_t) (feed) << 16))
+#define DEFAULT_CLEVEL CLEVEL (700, 45)
+#define CMOY_CLEVEL CLEVEL (700, 60)
+#define JMEIER_CLEVEL CLEVEL (650, 95)
+#endif
+
+#define MIN_FCUT 300
+#define MAX_FCUT 2000
+#define MIN_FEED 10
+#define MAX_FEED 150
+
+typedef double Vector __attribute__ ((vector_size (2 * sizeof (double))));
+
+struct ImagingParams
+{
+    /* out_left = ll * left + rl * right, out_right = lr * left + rr * right */
+    float ll, rl, lr, rr;
+
+    bool crossfeed;
+    double a0_lo, b1_lo;
+    double a0_hi, a1_hi, b1_hi;
+    double gain;
+};
+
+struct CrossfeedState
+{
+    Vector lo, hi, asis;
+};
+
+static const char imaging_about[] =
+ N_("Stereo Imaging Plugin for Audacious\n"
+    "Copyright 2026 Audacious developers\n\n"
+    "Adjusts the stereo width, optionally removes centered voices, and "
+    "applies the Bauer stereophonic-to-binaural crossfeed for headphone "
+    "listening, all in one pass.");
+
+static const char * const imaging_defaults[] = {
+    "width", "1",
+    "voice_removal", "FALSE",
+    "crossfeed", "TRUE",
+    "feed", "45",
+    "fcut", "700",
+    nullptr
+};
+
+static void params_changed ();
+static void set_default_preset ();
+static void set_cmoy_preset ();
+static void set_jmeier_preset ();
+
+static const PreferencesWidget preset_widgets[] = {
+    WidgetLabel (N_("Presets:")),
+    WidgetButton (N_("Default"), {set_default_preset}),
+    WidgetButton ("C. Moy", {set_cmoy_preset}),
+    WidgetButton ("J. Meier", {set_jmeier_preset})
+};
+
+static const PreferencesWidget imaging_widgets[] = {
+    WidgetLabel (N_("<b>Stereo Width</b>")),
+    WidgetSpin (N_("Width:"),
+        WidgetFloat ("stereo-imaging", "width", params_changed),
+        {0, 10, 0.1}),
+    WidgetCheck (N_("Remove voice"),
+        WidgetBool ("stereo-imaging", "voice_removal", params_changed)),
+    WidgetLabel (N_("<b>Crossfeed</b>")),
+    WidgetCheck (N_("Enable crossfeed"),
+        WidgetBool ("stereo-imaging", "crossfeed", params_changed)),
+    WidgetSpin (N_("Feed level:"),
+        WidgetInt ("stereo-imaging", "feed", params_changed, "stereo-imaging preset loaded"),
+        {MIN_FEED, MAX_FEED, 1, N_("x1/10 dB")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Cut frequency:"),
+        WidgetInt ("stereo-imaging", "fcut", params_changed, "stereo-imaging preset loaded"),
+        {MIN_FCUT, MAX_FCUT, 1, N_("Hz")},
+        WIDGET_CHILD),
+    WidgetBox ({{preset_widgets}, true}, WIDGET_CHILD)
+};
+
+static const PluginPreferences imaging_prefs = {{imaging_widgets}};
+
+class StereoImaging : public EffectPlugin
+{
+public:
+    static constexpr PluginInfo info = {
+        N_("Stereo Imaging"),
+        PACKAGE,
+        imaging_about,
+        & imaging_prefs
+    };
+
+    constexpr StereoImaging () : EffectPlugin (info, 0, true) {}
+
+    bool init () override;
+
+    void start (int & channels, int & rate) override;
+    Index<float> & process (Index<float> & data) override;
+    bool flush (bool force) override;
+};
+
+EXPORT PROFILED (StereoImaging) aud_plugin_instance;
+
+static std::atomic<bool> params_dirty (true);
+
+static int imaging_channels, imaging_rate;
+static ImagingParams params;
+static CrossfeedState state;
+
+static void params_changed ()
+{
+    params_dirty = true;
+}
+
+static void set_preset (uint32_t preset)
+{
+    aud_set_int ("stereo-imaging", "feed", preset >> 16);
+    aud_set_int ("stereo-imaging", "fcut", preset & 0xffff);
+
+    params_dirty = true;
+    hook_call ("stereo-imaging preset loaded", nullptr);
+}
+
+static void set_default_preset ()
+    { set_preset (DEFAULT_CLEVEL); }
+static void set_cmoy_preset ()
+    { set_preset (CMOY_CLEVEL); }
+static void set_jmeier_preset ()
+    { set_preset (JMEIER_CLEVEL); }
+
+static void update_params ()
+{
+    float width = aud_get_double ("stereo-imaging", "width");
+
+    /* left = mid + side * width, right = mid - side * width,
+     * with mid = (left + right) / 2 and side = (left - right) / 2 */
+    if (aud_get_bool ("stereo-imaging", "voice_removal"))
+    {
+        /* without the mid signal, both channels get the (mono) side signal */
+        params.ll = params.lr = width;
+        params.rl = params.rr = -width;
+    }
+    else
+    {
+        params.ll = params.rr = (1 + width) / 2;
+        params.rl = params.lr = (1 - width) / 2;
+    }
+
+    params.crossfeed = aud_get_bool ("stereo-imaging", "crossfeed");
+
+    /* filter design as in libbs2b */
+    int fcut = aud::clamp (aud_get_int ("stereo-imaging", "fcut"), MIN_FCUT, MAX_FCUT);
+    int feed = aud::clamp (aud_get_int ("stereo-imaging", "feed"), MIN_FEED, MAX_FEED);
+
+    double level = feed / 10.0;
+    double gb_lo = level * -5 / 6 - 3;
+    double gb_hi = level / 6 - 3;
+    double g_lo = pow (10, gb_lo / 20);
+    double g_hi = 1 - pow (10, gb_hi / 20);
+    double fc_hi = fcut * pow (2, (gb_lo - 20 * log10 (g_hi)) / 12);
+
+    double x = exp (-2 * M_PI * fcut / imaging_rate);
+    params.b1_lo = x;
+    params.a0_lo = g_lo * (1 - x);
+
+    x = exp (-2 * M_PI * fc_hi / imaging_rate);
+    params.b1_hi = x;
+    params.a0_hi = 1 - g_hi * (1 - x);
+    params.a1_hi = -x;
+
+    params.gain = 1 / (1 - g_hi + g_lo);
+}
+
+bool StereoImaging::init ()
+{
+    aud_config_set_defaults ("stereo-imaging", imaging_defaults);
+    return true;
+}
+
+void StereoImaging::start (int & channels, int & rate)
+{
+    imaging_channels = channels;
+    imaging_rate = rate;
+
+    params_dirty = false;
+    update_params ();
+
+    state = CrossfeedState ();
+}
+
+Index<float> & StereoImaging::process (Index<float> & data)
+{
+    if (imaging_channels != 2)
+        return data;
+
+    if (params_dirty.exchange (false))
+        update_params ();
+
+    /* copy everything to locals so that the compiler can keep it in registers */
+    const ImagingParams p = params;
+    Vector lo = state.lo, hi = state.hi, asis = state.asis;
+
+    float * end = data.end ();
+
+    for (float * f = data.begin (); f < end; f += 2)
+    {
+        Vector in = {
+            p.ll * f[0] + p.rl * f[1],
+            p.lr * f[0] + p.rr * f[1]
+        };
+
+        if (p.crossfeed)
+        {
+            lo = p.a0_lo * in + p.b1_lo * lo;
+            hi = p.a0_hi * in + p.a1_hi * asis + p.b1_hi * hi;
+            asis = in;
+
+            in = (hi + Vector {lo[1], lo[0]}) * p.gain;
+        }
+
+        f[0] = in[0];
+        f[1] = in[1];
+    }
+
+    state = {lo, hi, asis};
+    return data;
+}
+
+bool StereoImaging::flush (bool force)
+{
+    state = CrossfeedState ();
+    return true;
+}
@@ -7,6 +7,8 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/profiler.h"
+
 class ExtraStereo : public EffectPlugin
 {
 public:
@@ -30,7 +32,7 @@ public:
     Index<float> & process (Index<float> & data) override;
 };
 
-EXPORT ExtraStereo aud_plugin_instance;
+EXPORT PROFILED (ExtraStereo) aud_plugin_instance;
 
 const char ExtraStereo::about[] =
  N_("Extra Stereo Plugin\n\n"
@@ -21,6 +21,8 @@
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
 
+#include "../effect-common/profiler.h"
+
 class VoiceRemoval : public EffectPlugin
 {
 public:
@@ -35,7 +37,7 @@ public:
     Index<float> & process (Index<float> & data) override;
 };
 
-EXPORT VoiceRemoval aud_plugin_instance;
+EXPORT PROFILED (VoiceRemoval) aud_plugin_instance;
 
 static int voice_channels;
 